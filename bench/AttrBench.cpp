@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+/*
+ * Microbenchmarks of the attribute layer on the mock instrument, mostly
+ * without injected latency, so the cost measured is that of the library
+ * and the in-process registry:
+ * - reader and writer functions of LiberaAttr.h
+ * - LiberaSignalAttr::GetData
+ * - LiberaClient::UpdateScalar dispatch
+ * - registry dump (TreeWalk) of large trees
+ * - full poll cycles (UpdateAttr) as reported by the poll statistics,
+ *   without and with registry read latency
+ * Prints one JSON object per line.
+ */
+
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+#include <mock/MockBackend.h>
+
+#include "LiberaClient.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char *c_address("mock-attr-bench");
+const size_t c_boards(20); // parent nodes the bench attributes are spread over
+
+/**
+ * Median time of one call in nanoseconds, a_iter calls per sample.
+ */
+template <typename F>
+double Measure(F a_fn, size_t a_iter)
+{
+    std::vector<double> samples;
+    a_fn(); // warm up
+    for (size_t s(0); s < 9; ++s) {
+        Clock::time_point t0(Clock::now());
+        for (size_t i(0); i < a_iter; ++i) {
+            a_fn();
+        }
+        samples.push_back(
+            std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / a_iter);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+/*******************************************************************************
+ * Reader and writer functions, each on a node of the registry type it
+ * converts from.
+ */
+template <typename R>
+void Reader(const char *a_name, mci::Node &a_root, const char *a_path,
+    R (*a_fn)(LiberaNodes &))
+{
+    LiberaNodes nodes(a_path);
+    nodes.Resolve(a_root);
+    volatile R sink;
+    const double ns(Measure([&]() { sink = a_fn(nodes); }, 100000));
+    (void)sink;
+    std::printf("{\"bench\":\"attr\",\"case\":\"reader\",\"name\":\"%s\","
+        "\"path\":\"%s\",\"ns\":%.1f}\n", a_name, a_path, ns);
+}
+
+template <typename T, typename V>
+void Writer(const char *a_name, mci::Node &a_root, const char *a_path,
+    void (*a_fn)(LiberaNodes &, const T), V a_val)
+{
+    LiberaNodes nodes(a_path);
+    nodes.Resolve(a_root);
+    const T val(static_cast<T>(a_val));
+    const double ns(Measure([&]() { a_fn(nodes, val); }, 100000));
+    std::printf("{\"bench\":\"attr\",\"case\":\"writer\",\"name\":\"%s\","
+        "\"path\":\"%s\",\"ns\":%.1f}\n", a_name, a_path, ns);
+}
+
+void Converters()
+{
+    std::shared_ptr<mock::Instrument> box(mock::Instrument::Create(c_address));
+    box->Add("nm", int32_t(1234567));
+    box->Add("k", uint32_t(12345678));
+    box->Add("ull", uint64_t(1) << 40);
+    box->Add("flag", true);
+    box->Add("mode", int64_t(1));
+    box->Add("temp", 45.5);
+    box->Add("dsc.adjust", true);
+    box->Add("dsc.type", int64_t(1));
+    box->Add("fans.front", 5000.0);
+    box->Add("fans.middle", 4900.0);
+    box->Add("fans.rear", 5100.0);
+    box->Add("cpu.ID_4.value", 12.0);
+    box->Add("cpu.ID_5.value", 3.0);
+    box->Add("mem.ID_0.value", 1e9);
+    box->Add("mem.ID_1.value", 4e8);
+    box->Add("spec", std::vector<uint32_t>(16, 7));
+
+    mci::Node root(mci::Connect(c_address, mci::Root::Application));
+    Reader("DoRead<double>", root, "temp", LiberaScalarAttr<Tango::DevDouble>::DoRead);
+    Reader("DoRead<long>", root, "nm", LiberaScalarAttr<Tango::DevLong>::DoRead);
+    Reader("DoRead<bool>", root, "flag", LiberaScalarAttr<Tango::DevBoolean>::DoRead);
+    Reader("NM2MM", root, "nm", LiberaAttr::NM2MM);
+    Reader("K2MM", root, "k", LiberaAttr::K2MM);
+    Reader("INT2DBL", root, "nm", LiberaAttr::INT2DBL);
+    Reader("ULONG2LONG", root, "k", LiberaAttr::ULONG2LONG);
+    Reader("ULL2LONG", root, "ull", LiberaAttr::ULL2LONG);
+    Reader("ULL2SHORT", root, "ull", LiberaAttr::ULL2SHORT);
+    Reader("ULL2DBL", root, "ull", LiberaAttr::ULL2DBL);
+    Reader("NEGATE", root, "flag", LiberaAttr::NEGATE);
+    Reader("ENUM2BOOL", root, "mode", LiberaAttr::ENUM2BOOL);
+    Reader("DSC2SHORT", root, "dsc", LiberaAttr::DSC2SHORT);
+    Reader("FAN2SHORT", root, "fans.", LiberaAttr::FAN2SHORT);
+    Reader("DBL2SHORT", root, "temp", LiberaAttr::DBL2SHORT);
+    Reader("CPU2LONG", root, "cpu", LiberaAttr::CPU2LONG);
+    Reader("MEM2LONG", root, "mem", LiberaAttr::MEM2LONG);
+    Reader("SPEC2LONG", root, "spec", LiberaAttr::SPEC2LONG);
+    Reader("USHORT2SHORT", root, "mode", LiberaAttr::USHORT2SHORT);
+    Reader("ULONGLONG2LONG", root, "ull", LiberaAttr::ULONGLONG2LONG);
+    Reader("ULONG2LONGTHRSP", root, "k", LiberaAttr::ULONG2LONGTHRSP);
+
+    Writer("DoWrite<double>", root, "temp", LiberaScalarAttr<Tango::DevDouble>::DoWrite, 46.5);
+    Writer("DoWrite<long>", root, "nm", LiberaScalarAttr<Tango::DevLong>::DoWrite, 42);
+    Writer("DoWrite<bool>", root, "flag", LiberaScalarAttr<Tango::DevBoolean>::DoWrite, true);
+    Writer("MM2NM", root, "nm", LiberaAttr::MM2NM, 1.5);
+    Writer("MM2K", root, "k", LiberaAttr::MM2K, 1.5);
+    Writer("DBL2INT", root, "nm", LiberaAttr::DBL2INT, 1e3);
+    Writer("LONG2ULONG", root, "k", LiberaAttr::LONG2ULONG, 42);
+    Writer("DBL2ULL", root, "ull", LiberaAttr::DBL2ULL, 1e12);
+    Writer("NEGATE", root, "flag", LiberaAttr::NEGATE, false);
+    Writer("BOOL2ENUM", root, "mode", LiberaAttr::BOOL2ENUM, true);
+    Writer("SHORT2DSC", root, "dsc", LiberaAttr::SHORT2DSC, 2);
+    Writer("LONG2SPEC", root, "spec", LiberaAttr::LONG2SPEC, 9);
+    Writer("SHORT2USHORT", root, "mode", LiberaAttr::SHORT2USHORT, 3);
+    Writer("LONG2ULONGLONG", root, "ull", LiberaAttr::LONG2ULONGLONG, 42);
+
+    mci::Disconnect(c_address, mci::Root::Application);
+    mock::Instrument::Remove(c_address);
+}
+
+/*******************************************************************************
+ * Signal with a_cols spectrum attributes, the column count is fixed at
+ * compile time by the constructor.
+ */
+template <typename TangoType>
+LiberaSignalAttr<TangoType> *MakeSignal(size_t a_rows, Tango::DevBoolean *&a_enabled,
+    Tango::DevLong *&a_length, std::vector<TangoType *> &c)
+{
+    typedef LiberaSignalAttr<TangoType> Signal;
+    switch (c.size()) {
+    case 4:
+        return new Signal("signal", a_rows, a_enabled, a_length,
+            c[0], c[1], c[2], c[3]);
+    case 8:
+        return new Signal("signal", a_rows, a_enabled, a_length,
+            c[0], c[1], c[2], c[3], c[4], c[5], c[6], c[7]);
+    case 12:
+        return new Signal("signal", a_rows, a_enabled, a_length,
+            c[0], c[1], c[2], c[3], c[4], c[5], c[6], c[7], c[8], c[9], c[10], c[11]);
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * GetData of a signal with a_cols columns of a_rows atoms. The signal is
+ * not enabled, a new buffer is acquired before each timed GetData.
+ */
+template <typename TangoType>
+void GetData(size_t a_cols, size_t a_rows)
+{
+    typedef typename LiberaSignalAttr<TangoType>::Traits Traits;
+    std::shared_ptr<mock::Instrument> box(mock::Instrument::Create(c_address));
+    // unpaced stream, every read returns at once
+    box->AddStream<Traits>("signal", a_cols, mock::Sine(1e4, 1000, 10), 0);
+    mci::Node root(mci::Connect(c_address, mci::Root::Application));
+
+    Tango::DevBoolean *enabled(NULL);
+    Tango::DevLong *length(NULL);
+    std::vector<TangoType *> cols(a_cols, NULL);
+    std::unique_ptr<LiberaSignalAttr<TangoType> > p(
+        MakeSignal<TangoType>(a_rows, enabled, length, cols));
+    LiberaSignal &signal(*p);
+    signal.Connect(root);
+
+    const size_t iter(std::max<size_t>(1, 2000000 / (a_rows * a_cols)));
+    std::vector<double> samples;
+    for (size_t s(0); s < 10; ++s) {
+        Clock::duration total(Clock::duration::zero());
+        for (size_t i(0); i < iter; ++i) {
+            signal.Update();
+            const Clock::time_point t0(Clock::now());
+            signal.GetData();
+            total += Clock::now() - t0;
+        }
+        if (s > 0) { // first sample is warm up
+            samples.push_back(
+                std::chrono::duration<double, std::nano>(total).count() / iter);
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+    const double ns(samples[samples.size() / 2]);
+    std::printf("{\"bench\":\"attr\",\"case\":\"getdata\",\"type\":\"%s\","
+        "\"cols\":%zu,\"rows\":%zu,\"ns\":%.0f,"
+        "\"ns_per_atom\":%.3f,\"ok\":%s}\n",
+        sizeof(TangoType) == 8 ? "double" : "short",
+        a_cols, a_rows, ns, ns / a_rows,
+        signal.IsConnected() ? "true" : "false");
+
+    p.reset();
+    mci::Disconnect(c_address, mci::Root::Application);
+    mock::Instrument::Remove(c_address);
+}
+
+/*******************************************************************************
+ * Client connected to a_box with a_attrs double attributes spread over
+ * c_boards nodes, polled with a_period. The attribute nodes are added to
+ * the registry before connecting.
+ */
+struct Client {
+    Client(const std::shared_ptr<mock::Instrument> &a_box, size_t a_attrs,
+        uint32_t a_period)
+      : box(a_box),
+        attrs(a_attrs, NULL)
+    {
+        for (size_t i(0); i < a_attrs; ++i) {
+            box->Add(Path(i), static_cast<double>(i));
+        }
+        client.reset(new LiberaClient(NULL, c_address));
+        client->SetReconnect(false);
+        for (size_t i(0); i < a_attrs; ++i) {
+            client->AddScalar(Path(i), attrs[i], a_period);
+        }
+        client->Connect();
+    }
+
+    ~Client()
+    {
+        client->Disconnect();
+        client.reset();
+        mock::Instrument::Remove(c_address);
+    }
+
+    static std::string Path(size_t a_index)
+    {
+        std::ostringstream path;
+        path << "boards.board" << a_index % c_boards << ".attr" << a_index / c_boards;
+        return path.str();
+    }
+
+    std::shared_ptr<mock::Instrument> box;
+    std::vector<Tango::DevDouble *>   attrs; // referenced by the client
+    std::unique_ptr<LiberaClient>     client;
+};
+
+void UpdateScalar(size_t a_attrs)
+{
+    Client c(mock::Instrument::Create(c_address), a_attrs, ePollSlow);
+    size_t next(0);
+    double val(0);
+    const double ns(Measure([&]() {
+        c.client->UpdateScalar(c.attrs[next], val);
+        next = next + 1 < a_attrs ? next + 1 : 0;
+        val += 1;
+    }, 100000));
+    std::printf("{\"bench\":\"attr\",\"case\":\"update_scalar\",\"attrs\":%zu,"
+        "\"ns\":%.1f,\"ok\":%s}\n",
+        a_attrs, ns, c.client->m_errorFlag ? "false" : "true");
+}
+
+/**
+ * Full poll cycles with all attributes due each millisecond, timed by
+ * the client itself. Each registry read takes a_getUs, the reads of a
+ * cycle are spread over the shared fetch threads.
+ */
+void UpdateAttr(size_t a_attrs, uint32_t a_getUs)
+{
+    Client c(mock::Instrument::Create(c_address), a_attrs, 1);
+    mock::SetLatency(mock::eCallGet, std::chrono::microseconds(a_getUs));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // warm up
+    const LiberaPollStats before(c.client->GetPollStats());
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    const LiberaPollStats after(c.client->GetPollStats());
+    mock::ResetInjection();
+    const uint64_t polls(after.polls - before.polls);
+    const uint64_t attrs(after.attrs - before.attrs);
+    const double total(after.totalNs - before.totalNs);
+    const double ns(polls ? total / polls : 0);
+    std::printf("{\"bench\":\"attr\",\"case\":\"update_attr\",\"attrs\":%zu,"
+        "\"get_us\":%u,\"polls\":%llu,\"attrs_per_poll\":%.1f,\"ns\":%.0f,"
+        "\"ns_per_attr\":%.1f,\"ok\":%s}\n",
+        a_attrs, a_getUs, static_cast<unsigned long long>(polls),
+        polls ? double(attrs) / polls : 0.0, ns, attrs ? total / attrs : 0.0,
+        polls && c.client->IsConnected() ? "true" : "false");
+}
+
+/**
+ * Registry dump of a tree with a_fanout children on each of 3 levels
+ * below the root of the dump, all leaves hold values.
+ */
+void TreeWalk(size_t a_fanout, bool a_values)
+{
+    std::shared_ptr<mock::Instrument> box(mock::Instrument::Create(c_address));
+    size_t nodes(1);
+    for (size_t i(0); i < a_fanout; ++i) {
+        for (size_t j(0); j < a_fanout; ++j) {
+            for (size_t k(0); k < a_fanout; ++k) {
+                std::ostringstream path;
+                path << "tree.n" << i << ".n" << j << ".v" << k;
+                box->Add(path.str(), static_cast<double>(k));
+            }
+        }
+    }
+    nodes += a_fanout + a_fanout * a_fanout + a_fanout * a_fanout * a_fanout;
+    Client c(box, 0, ePollSlow);
+    const std::string cmd(a_values ? "tree values" : "tree");
+    size_t lines(0);
+    const double ns(Measure([&]() {
+        Tango::DevVarStringArray out;
+        c.client->MagicCommand(cmd, &out);
+        lines = out.length();
+    }, std::max<size_t>(1, 20000 / nodes)));
+    std::printf("{\"bench\":\"attr\",\"case\":\"treewalk\",\"nodes\":%zu,"
+        "\"values\":%s,\"lines\":%zu,\"ns\":%.0f,\"ns_per_node\":%.1f}\n",
+        nodes, a_values ? "true" : "false", lines, ns, ns / nodes);
+}
+
+} // namespace
+
+int main()
+{
+    Converters();
+
+    // ADC, TbT and SA like column counts and buffer lengths
+    const size_t rows[] = { 1000, 10000, 100000 };
+    for (size_t r(0); r < sizeof(rows) / sizeof(rows[0]); ++r) {
+        GetData<Tango::DevDouble>(8, rows[r]);
+        GetData<Tango::DevDouble>(12, rows[r]);
+        GetData<Tango::DevShort>(4, rows[r]);
+    }
+
+    const size_t attrs[] = { 100, 500, 1000 };
+    for (size_t a(0); a < sizeof(attrs) / sizeof(attrs[0]); ++a) {
+        UpdateScalar(attrs[a]);
+    }
+    for (size_t a(0); a < sizeof(attrs) / sizeof(attrs[0]); ++a) {
+        UpdateAttr(attrs[a], 0);
+        UpdateAttr(attrs[a], 200);
+    }
+
+    const size_t fanout[] = { 10, 22, 46 }; // about 1k, 10k, 100k nodes
+    for (size_t f(0); f < sizeof(fanout) / sizeof(fanout[0]); ++f) {
+        TreeWalk(fanout[f], false);
+        TreeWalk(fanout[f], true);
+    }
+    return EXIT_SUCCESS;
+}
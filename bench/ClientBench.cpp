@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+/*
+ * End to end benchmark of LiberaClient against the mock instrument: the
+ * real poll loop, worker pool and signal threads run on a simulated
+ * registry with injected call latency and failures.
+ * Prints one JSON object per line.
+ *
+ * Options are given as name=value arguments, see Options below.
+ */
+
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+#include <mock/MockBackend.h>
+
+#include "LiberaClient.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t c_boards(20); // parent nodes the attributes are spread over
+
+struct Options {
+    size_t   attrs;     // scalar attributes
+    uint32_t period;    // poll period in ms
+    double   seconds;   // measured run time
+    uint32_t getUs;     // latency of a registry read in us
+    double   getFail;   // probability of a failed registry read
+    size_t   length;    // signal buffer length in atoms
+    double   rate;      // stream atoms per second
+    uint32_t dodMs;     // data on demand trigger and read period
+    bool     outage;    // measure recovery after the instrument restarts
+};
+
+bool Parse(int argc, char *argv[], Options &a_opt)
+{
+    for (int i(1); i < argc; ++i) {
+        const char *eq(std::strchr(argv[i], '='));
+        if (!eq) {
+            return false;
+        }
+        const std::string name(argv[i], eq - argv[i]);
+        const double v(std::atof(eq + 1));
+        if (name == "attrs")        a_opt.attrs = v;
+        else if (name == "period")  a_opt.period = v;
+        else if (name == "seconds") a_opt.seconds = v;
+        else if (name == "get_us")  a_opt.getUs = v;
+        else if (name == "get_fail") a_opt.getFail = v;
+        else if (name == "length")  a_opt.length = v;
+        else if (name == "rate")    a_opt.rate = v;
+        else if (name == "dod_ms")  a_opt.dodMs = v;
+        else if (name == "outage")  a_opt.outage = v != 0;
+        else return false;
+    }
+    return true;
+}
+
+double Seconds(Clock::duration a_d)
+{
+    return std::chrono::duration<double>(a_d).count();
+}
+
+double Us(uint64_t a_ns)
+{
+    return a_ns / 1000.0;
+}
+
+void ReportLatency(const std::string &a_name, const LiberaLatencySummary &a_s)
+{
+    std::printf("{\"bench\":\"client\",\"case\":\"latency\",\"name\":\"%s\","
+        "\"count\":%llu,\"mean_us\":%.1f,\"p50_us\":%.1f,\"p90_us\":%.1f,"
+        "\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f}\n",
+        a_name.c_str(), static_cast<unsigned long long>(a_s.count),
+        Us(a_s.meanNs), Us(a_s.p50Ns), Us(a_s.p90Ns), Us(a_s.p99Ns),
+        Us(a_s.p999Ns), Us(a_s.maxNs));
+}
+
+/**
+ * Scalar latencies are merged into one line per operation, the rest is
+ * reported per signal step.
+ */
+void ReportLatencies(LiberaClient &a_client)
+{
+    std::vector<std::pair<std::string, LiberaLatencySummary> > all;
+    a_client.GetLatency(all);
+    LiberaLatencySummary reads = {}, writes = {};
+    for (auto i = all.begin(); i != all.end(); ++i) {
+        const std::string &name(i->first);
+        const bool read(name.size() > 5 && name.compare(name.size() - 5, 5, ":read") == 0);
+        const bool write(name.size() > 6 && name.compare(name.size() - 6, 6, ":write") == 0);
+        if (!read && !write) {
+            ReportLatency(name, i->second);
+            continue;
+        }
+        // per attribute percentiles can't be merged, keep the worst
+        LiberaLatencySummary &m(read ? reads : writes);
+        const LiberaLatencySummary &s(i->second);
+        m.meanNs = (m.meanNs * m.count + s.meanNs * s.count) / (m.count + s.count);
+        m.count += s.count;
+        m.p50Ns = std::max(m.p50Ns, s.p50Ns);
+        m.p90Ns = std::max(m.p90Ns, s.p90Ns);
+        m.p99Ns = std::max(m.p99Ns, s.p99Ns);
+        m.p999Ns = std::max(m.p999Ns, s.p999Ns);
+        m.maxNs = std::max(m.maxNs, s.maxNs);
+    }
+    if (reads.count) {
+        ReportLatency("scalars:read", reads);
+    }
+    if (writes.count) {
+        ReportLatency("scalars:write", writes);
+    }
+}
+
+void ReportCalls(double a_seconds)
+{
+    const char *names[mock::eCallCount] = {
+        "connect", "ping", "get", "set", "execute",
+        "stream_read", "dod_open", "dod_read" };
+    std::printf("{\"bench\":\"client\",\"case\":\"calls\",\"seconds\":%.2f", a_seconds);
+    for (size_t c(0); c < mock::eCallCount; ++c) {
+        std::printf(",\"%s\":%llu", names[c], static_cast<unsigned long long>(
+            mock::GetCallCount(static_cast<mock::Call_e>(c))));
+    }
+    std::printf("}\n");
+}
+
+/**
+ * Attribute memory of one signal, allocated by the signal object.
+ */
+template <typename TangoType>
+struct SignalAttrs {
+    explicit SignalAttrs(size_t a_cols)
+      : enabled(NULL),
+        length(NULL),
+        cols(a_cols, NULL),
+        signal(NULL),
+        reads(0)
+    {
+    }
+
+    Tango::DevBoolean     *enabled;
+    Tango::DevLong        *length;
+    std::vector<TangoType *> cols;
+    LiberaSignal          *signal;
+    uint64_t               reads;
+
+    /**
+     * Tango attribute read: fetch fresh data.
+     */
+    void Read()
+    {
+        if (signal->IsUpdated()) {
+            signal->GetData();
+            ++reads;
+        }
+    }
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options opt = { 400, 100, 3.0, 50, 0.0, 1000, 10000.0, 100, true };
+    if (!Parse(argc, argv, opt)) {
+        std::fprintf(stderr, "usage: %s [attrs=N] [period=ms] "
+            "[seconds=S] [get_us=us] [get_fail=p] [length=N] [rate=atoms/s] "
+            "[dod_ms=ms] [outage=0|1]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string address("mock-bench");
+    std::shared_ptr<mock::Instrument> box(mock::Instrument::Create(address));
+    for (size_t i(0); i < opt.attrs; ++i) {
+        std::ostringstream path;
+        path << "boards.board" << i % c_boards << ".attr" << i / c_boards;
+        box->Add(path.str(), static_cast<double>(i));
+    }
+    typedef LiberaSignalAttr<Tango::DevDouble>::Traits TraitsD;
+    typedef LiberaSignalAttr<Tango::DevShort>::Traits  TraitsS;
+    box->AddStream<TraitsD>("signals.sa", 8, mock::Sine(1e6, 1000, 10), opt.rate);
+    box->AddDod<TraitsS>("signals.adc", 4, mock::Sine(8000, 50, 20),
+        std::chrono::milliseconds(opt.dodMs));
+
+    mock::ResetInjection();
+    mock::SetLatency(mock::eCallGet, std::chrono::microseconds(opt.getUs));
+    mock::SetFailureRate(mock::eCallGet, opt.getFail);
+
+    // attribute memory is referenced by the client, it must outlive it
+    std::vector<Tango::DevDouble *> scalars(opt.attrs, NULL);
+    SignalAttrs<Tango::DevDouble> sa(8);
+    SignalAttrs<Tango::DevShort> adc(4);
+
+    LiberaClient client(nullptr, address);
+    for (size_t i(0); i < opt.attrs; ++i) {
+        std::ostringstream path;
+        path << "boards.board" << i % c_boards << ".attr" << i / c_boards;
+        client.AddScalar(path.str(), scalars[i], opt.period);
+    }
+    sa.signal = client.AddSignal<Tango::DevDouble>("signals.sa", opt.length,
+        sa.enabled, sa.length, sa.cols[0], sa.cols[1], sa.cols[2], sa.cols[3],
+        sa.cols[4], sa.cols[5], sa.cols[6], sa.cols[7]);
+    adc.signal = client.AddSignal<Tango::DevShort>("signals.adc", opt.length,
+        adc.enabled, adc.length, adc.cols[0], adc.cols[1], adc.cols[2], adc.cols[3]);
+    adc.signal->SetPeriod(opt.dodMs);
+    // stream reads block until the buffer is filled, no need to wait more
+    sa.signal->SetPeriod(0);
+
+    const Clock::time_point t0(Clock::now());
+    const bool connected(client.Connect());
+    std::printf("{\"bench\":\"client\",\"case\":\"connect\",\"nodes\":%zu,"
+        "\"attrs\":%zu,\"ok\":%s,\"ms\":%.1f}\n",
+        box->GetNodeCount(), opt.attrs, connected ? "true" : "false",
+        Seconds(Clock::now() - t0) * 1e3);
+    if (!connected) {
+        return EXIT_FAILURE;
+    }
+    sa.signal->Enable();
+    adc.signal->Enable();
+    client.SetReconnect(true, 100, 1000);
+    {
+        // recording is off by default, enable it the way Tango clients do
+        Tango::DevVarStringArray out;
+        client.MagicCommand("latency on", &out);
+        const bool enabled(LiberaLatency::IsEnabled());
+        std::printf("{\"bench\":\"client\",\"case\":\"latency_on\",\"ok\":%s}\n",
+            enabled ? "true" : "false");
+        if (!enabled) {
+            return EXIT_FAILURE;
+        }
+    }
+    client.ResetLatency();
+    mock::ResetInjection();
+    mock::SetLatency(mock::eCallGet, std::chrono::microseconds(opt.getUs));
+    mock::SetFailureRate(mock::eCallGet, opt.getFail);
+
+    // the main thread stands in for Tango clients reading the spectra
+    const LiberaPollStats before(client.GetPollStats());
+    const Clock::time_point start(Clock::now());
+    const Clock::time_point end(start + std::chrono::microseconds(
+        static_cast<int64_t>(opt.seconds * 1e6)));
+    while (Clock::now() < end) {
+        sa.Read();
+        adc.Read();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const double elapsed(Seconds(Clock::now() - start));
+    const LiberaPollStats after(client.GetPollStats());
+
+    const uint64_t polls(after.polls - before.polls);
+    const uint64_t polled(after.attrs - before.attrs);
+    std::printf("{\"bench\":\"client\",\"case\":\"poll\",\"attrs\":%zu,"
+        "\"period_ms\":%u,\"get_us\":%u,\"get_fail\":%.3f,"
+        "\"seconds\":%.2f,\"polls\":%llu,\"attrs_per_s\":%.0f,"
+        "\"cycle_mean_us\":%.1f,\"cycle_max_us\":%.1f}\n",
+        opt.attrs, opt.period, opt.getUs, opt.getFail, elapsed,
+        static_cast<unsigned long long>(polls), polled / elapsed,
+        polls ? Us((after.totalNs - before.totalNs) / polls) : 0.0,
+        Us(after.maxNs));
+    const LiberaDodStats dod(adc.signal->GetDodStats());
+    std::printf("{\"bench\":\"client\",\"case\":\"signals\",\"length\":%zu,"
+        "\"sa_reads_per_s\":%.1f,\"adc_reads_per_s\":%.1f,\"dod_opens\":%llu,"
+        "\"dod_reuses\":%llu}\n",
+        opt.length, sa.reads / elapsed, adc.reads / elapsed,
+        static_cast<unsigned long long>(dod.opens),
+        static_cast<unsigned long long>(dod.reuses));
+    ReportLatencies(client);
+    ReportCalls(elapsed);
+
+    bool ok(true);
+    if (opt.outage) {
+        // instrument restart: connection lost, restored by the supervisor
+        mock::SetFailureRate(mock::eCallGet, 0);
+        box->SetUp(false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        const uint64_t polled(client.GetPollStats().attrs);
+        const Clock::time_point up(Clock::now());
+        box->SetUp(true);
+        const Clock::time_point limit(up + std::chrono::seconds(10));
+        while (Clock::now() < limit &&
+            !(client.IsConnected() && client.GetPollStats().attrs > polled)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ok = client.IsConnected();
+        std::printf("{\"bench\":\"client\",\"case\":\"recovery\",\"ok\":%s,"
+            "\"ms\":%.1f}\n", ok ? "true" : "false", Seconds(Clock::now() - up) * 1e3);
+    }
+
+    client.Disconnect();
+    mock::Instrument::Remove(address);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
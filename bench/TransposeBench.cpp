@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+/*
+ * Microbenchmark of the signal buffer transpose kernels against the plain
+ * per column copy loop that LiberaSignalAttr::GetData used before.
+ * Prints one JSON object per line.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "LiberaTranspose.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Reference: column outer, row inner loop as in the original GetData.
+ */
+template <typename S, typename D>
+void Reference(const S *a_src, size_t a_stride, size_t a_rows,
+    D *const *a_dst, size_t a_cols)
+{
+    for (size_t i(0); i != a_cols; ++i) {
+        D *attr = a_dst[i];
+        for (size_t j(0); j < a_rows; ++j) {
+            attr[j] = a_src[j * a_stride + i];
+        }
+    }
+}
+
+/**
+ * Median time of one call in nanoseconds.
+ */
+template <typename F>
+double Measure(F a_fn, size_t a_atoms)
+{
+    // enough iterations for about 2M atoms per sample
+    const size_t iter(std::max<size_t>(1, 2000000 / a_atoms));
+    std::vector<double> samples;
+    a_fn(); // warm up
+    for (size_t s(0); s < 9; ++s) {
+        Clock::time_point t0(Clock::now());
+        for (size_t i(0); i < iter; ++i) {
+            a_fn();
+        }
+        samples.push_back(
+            std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / iter);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+void Report(const char *a_type, const char *a_case, size_t a_rows, size_t a_cols,
+    double a_ns, double a_ref_ns, bool a_ok)
+{
+    std::printf("{\"bench\":\"transpose\",\"type\":\"%s\",\"case\":\"%s\","
+        "\"rows\":%zu,\"cols\":%zu,\"ns\":%.0f,\"ns_per_atom\":%.3f,"
+        "\"speedup\":%.2f,\"ok\":%s}\n",
+        a_type, a_case, a_rows, a_cols, a_ns, a_ns / a_rows,
+        a_ref_ns / a_ns, a_ok ? "true" : "false");
+}
+
+template <typename S, typename D>
+bool Run(const char *a_type, size_t a_rows, size_t a_cols)
+{
+    std::vector<S> src(a_rows * a_cols);
+    for (size_t i(0); i < src.size(); ++i) {
+        src[i] = static_cast<S>(std::rand() - RAND_MAX / 2);
+    }
+    std::vector<std::vector<D> > ref(a_cols, std::vector<D>(a_rows));
+    std::vector<std::vector<D> > out(a_cols, std::vector<D>(a_rows));
+    std::vector<D *> ref_p, out_p;
+    for (size_t c(0); c < a_cols; ++c) {
+        ref_p.push_back(&ref[c][0]);
+        out_p.push_back(&out[c][0]);
+    }
+
+    const double ref_ns(Measure([&]() {
+        Reference(&src[0], a_cols, a_rows, &ref_p[0], a_cols);
+    }, a_rows));
+    Report(a_type, "reference", a_rows, a_cols, ref_ns, ref_ns, true);
+
+    bool ok(true);
+    const LiberaKernel_e kernels[] = { eKernelScalar, eKernelSse2, eKernelAvx2 };
+    for (size_t k(0); k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        if (!LiberaKernelSupported(kernels[k])) {
+            continue;
+        }
+        for (size_t c(0); c < a_cols; ++c) {
+            std::fill(out[c].begin(), out[c].end(), D(0));
+        }
+        const double ns(Measure([&]() {
+            LiberaTranspose(&src[0], a_cols, a_rows, &out_p[0], a_cols, kernels[k]);
+        }, a_rows));
+        const bool same(out == ref);
+        ok = ok && same;
+        Report(a_type, LiberaKernelName(kernels[k]), a_rows, a_cols, ns, ref_ns, same);
+    }
+    return ok;
+}
+
+} // namespace
+
+int main()
+{
+    // ADC, TbT and SA like column counts and buffer lengths
+    const size_t rows[] = { 1000, 10000, 100000 };
+    const size_t cols[] = { 4, 8, 12 };
+    bool ok(true);
+    for (size_t r(0); r < sizeof(rows) / sizeof(rows[0]); ++r) {
+        for (size_t c(0); c < sizeof(cols) / sizeof(cols[0]); ++c) {
+            ok = Run<int32_t, double>("int32", rows[r], cols[c]) && ok;
+            ok = Run<int16_t, int16_t>("int16", rows[r], cols[c]) && ok;
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,566 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include <map>
+#include <sstream>
+
+#include <mci/mci.h>
+#include <mci/mci_util.h>
+#include <mci/notification_client.h>
+#include <mock/MockBackend.h>
+
+#include "MockInternal.h"
+
+namespace {
+
+typedef std::pair<std::string, mci::Root> SessionKey;
+
+/**
+ * Instruments and open sessions of the process, intentionally never
+ * destroyed so that they outlive static destruction of any client.
+ */
+struct Registry {
+    std::mutex x;
+    std::map<std::string, std::shared_ptr<mock::Instrument> > instruments;
+    std::map<SessionKey, std::shared_ptr<mock::Session> >     sessions;
+};
+
+Registry &GetRegistry()
+{
+    static Registry *registry = new Registry();
+    return *registry;
+}
+
+/**
+ * Convert the value to the type of the node it is written to.
+ */
+mci::Value Convert(const mci::Value &a_val, mci::NodeValueType a_type)
+{
+    mci::Value v;
+    v.type = a_type;
+    v.array = a_val.array;
+    switch (a_type) {
+    case mci::eNvString:
+        v.s = a_val.ToString();
+        return v;
+    case mci::eNvBool:
+        v.i = a_val.As<double>() != 0;
+        v.u = v.i;
+        v.d = v.i;
+        return v;
+    case mci::eNvLong:
+    case mci::eNvLongLong:
+        v.i = a_val.As<int64_t>();
+        v.u = v.i;
+        v.d = v.i;
+        return v;
+    case mci::eNvULong:
+    case mci::eNvULongLong:
+        v.u = a_val.As<uint64_t>();
+        v.i = v.u;
+        v.d = v.u;
+        return v;
+    case mci::eNvDouble:
+        v.d = a_val.As<double>();
+        v.i = static_cast<int64_t>(v.d);
+        v.u = static_cast<uint64_t>(v.d);
+        return v;
+    default:
+        return a_val;
+    }
+}
+
+size_t Count(const mock::NodeData &a_node)
+{
+    size_t count(1);
+    for (auto i = a_node.children.begin(); i != a_node.children.end(); ++i) {
+        count += Count(**i);
+    }
+    return count;
+}
+
+} // namespace
+
+/*******************************************************************************
+ * mci::Value, mci::Node
+ */
+namespace mci {
+
+std::string Value::ToString() const
+{
+    std::ostringstream ss;
+    if (!array.empty()) {
+        for (size_t i(0); i < array.size(); ++i) {
+            ss << (i ? "," : "") << array[i];
+        }
+        return ss.str();
+    }
+    switch (type) {
+    case eNvBool:
+        return i ? "true" : "false";
+    case eNvLong:
+    case eNvLongLong:
+        ss << i;
+        break;
+    case eNvULong:
+    case eNvULongLong:
+        ss << u;
+        break;
+    case eNvDouble:
+        ss << d;
+        break;
+    case eNvString:
+        return s;
+    default:
+        break;
+    }
+    return ss.str();
+}
+
+Node::Node()
+{
+}
+
+Node::Node(const std::shared_ptr<mock::NodeData> &a_data,
+    const std::shared_ptr<mock::Session> &a_session)
+  : m_data(a_data),
+    m_session(a_session)
+{
+}
+
+bool Node::IsValid() const
+{
+    return m_data && m_session && m_session->open;
+}
+
+/**
+ * Destroying the root node closes its connection.
+ */
+void Node::Destroy()
+{
+    if (m_data && m_session && m_data->path.empty()) {
+        m_session->open = false;
+    }
+    m_data.reset();
+    m_session.reset();
+}
+
+void Node::Check() const
+{
+    if (!m_data || !m_session) {
+        throw istd::Exception("mock: invalid node");
+    }
+    if (!m_session->IsOpen()) {
+        istd_EXCEPTION("mock: not connected to " << m_session->address);
+    }
+}
+
+Node Node::GetNode(const Path &a_path) const
+{
+    Check();
+    std::shared_ptr<mock::NodeData> node(m_data);
+    for (auto i = a_path.begin(); i != a_path.end(); ++i) {
+        auto c = node->index.find(*i);
+        if (c == node->index.end()) {
+            istd_EXCEPTION("mock: no node " << mci::ToString(a_path));
+        }
+        node = node->children[c->second];
+    }
+    return Node(node, m_session);
+}
+
+Node Node::GetNode(size_t a_index) const
+{
+    Check();
+    if (a_index >= m_data->children.size()) {
+        istd_EXCEPTION("mock: no child " << a_index << " of " << mci::ToString(m_data->path));
+    }
+    return Node(m_data->children[a_index], m_session);
+}
+
+size_t Node::GetNodeCount() const
+{
+    Check();
+    return m_data->children.size();
+}
+
+void Node::Read(Value &a_val) const
+{
+    Check();
+    if (mock::Inject(mock::eCallGet)) {
+        istd_EXCEPTION("mock: injected get failure " << mci::ToString(m_data->path));
+    }
+    std::lock_guard<std::mutex> l(m_data->x);
+    if (m_data->value.type == eNvUndefined) {
+        istd_EXCEPTION("mock: no value " << mci::ToString(m_data->path));
+    }
+    a_val = m_data->value;
+}
+
+void Node::Write(const Value &a_val)
+{
+    Check();
+    if (mock::Inject(mock::eCallSet)) {
+        istd_EXCEPTION("mock: injected set failure " << mci::ToString(m_data->path));
+    }
+    {
+        std::lock_guard<std::mutex> l(m_data->x);
+        if (m_data->value.type == eNvUndefined) {
+            istd_EXCEPTION("mock: no value " << mci::ToString(m_data->path));
+        }
+        m_data->value = Convert(a_val, m_data->value.type);
+    }
+    mock::Notify(*m_data);
+}
+
+bool Node::Execute()
+{
+    Check();
+    if (mock::Inject(mock::eCallExecute)) {
+        istd_EXCEPTION("mock: injected execute failure " << mci::ToString(m_data->path));
+    }
+    if (!m_data->exec) {
+        istd_EXCEPTION("mock: not a command " << mci::ToString(m_data->path));
+    }
+    return m_data->exec();
+}
+
+Path Node::GetRelPath() const
+{
+    return m_data ? m_data->path : Path();
+}
+
+Path Node::GetFullPath() const
+{
+    return GetRelPath();
+}
+
+std::string Node::GetName() const
+{
+    return m_data ? m_data->name : std::string();
+}
+
+NodeValueType Node::GetValueType() const
+{
+    Check();
+    std::lock_guard<std::mutex> l(m_data->x);
+    return m_data->value.type;
+}
+
+bool Node::IsReadable() const
+{
+    return GetValueType() != eNvUndefined;
+}
+
+std::string Node::ToString(size_t) const
+{
+    Value v;
+    Read(v);
+    return v.ToString();
+}
+
+Path Tokenize(const std::string &a_path)
+{
+    Path path;
+    std::string::size_type start(0);
+    while (start < a_path.size()) {
+        std::string::size_type end(a_path.find('.', start));
+        if (end == std::string::npos) {
+            end = a_path.size();
+        }
+        if (end > start) {
+            path.push_back(a_path.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return path;
+}
+
+std::string ToString(const Path &a_path)
+{
+    std::string s;
+    for (auto i = a_path.begin(); i != a_path.end(); ++i) {
+        if (!s.empty()) {
+            s += '.';
+        }
+        s += *i;
+    }
+    return s;
+}
+
+/*******************************************************************************
+ * mci connection functions
+ */
+
+/**
+ * Open a new session, the platform root maps to the same registry as
+ * the application root.
+ */
+Node Connect(const char *a_address, Root a_root)
+{
+    if (mock::Inject(mock::eCallConnect)) {
+        istd_EXCEPTION("mock: injected connect failure " << a_address);
+    }
+    Registry &r(GetRegistry());
+    std::lock_guard<std::mutex> l(r.x);
+    auto i = r.instruments.find(a_address);
+    if (i == r.instruments.end() || !i->second->IsUp()) {
+        istd_EXCEPTION("mock: can not connect to " << a_address);
+    }
+    std::shared_ptr<mock::Session> session(std::make_shared<mock::Session>(
+        a_address, a_root, i->second->GetUpFlag()));
+    r.sessions[SessionKey(a_address, a_root)] = session;
+    return Node(i->second->GetRoot(), session);
+}
+
+void Disconnect(const char *a_address, Root a_root)
+{
+    Registry &r(GetRegistry());
+    std::lock_guard<std::mutex> l(r.x);
+    auto i = r.sessions.find(SessionKey(a_address, a_root));
+    if (i != r.sessions.end()) {
+        i->second->open = false;
+        r.sessions.erase(i);
+    }
+}
+
+/**
+ * Root node of the open session, invalid if there is none.
+ */
+Node GetNode(const char *a_address, Root a_root)
+{
+    Registry &r(GetRegistry());
+    std::lock_guard<std::mutex> l(r.x);
+    auto s = r.sessions.find(SessionKey(a_address, a_root));
+    auto i = r.instruments.find(a_address);
+    if (s == r.sessions.end() || !s->second->IsOpen() || i == r.instruments.end()) {
+        return Node();
+    }
+    return Node(i->second->GetRoot(), s->second);
+}
+
+ConnectionState Ping(const Node &a_node)
+{
+    if (mock::Inject(mock::eCallPing)) {
+        return Disconnected;
+    }
+    return a_node.IsValid() && a_node.GetSession()->IsOpen() ? Connected : Disconnected;
+}
+
+isig::SignalSourceSharedPtr CreateRemoteSignal(const Node &a_node)
+{
+    if (!a_node.IsValid() || !a_node.GetSession()->IsOpen()) {
+        throw istd::Exception("mock: not connected");
+    }
+    if (!a_node.GetData()->signal) {
+        istd_EXCEPTION("mock: no signal " << ToString(a_node.GetRelPath()));
+    }
+    return a_node.GetData()->signal;
+}
+
+/*******************************************************************************
+ * mci::NotificationClient
+ */
+NotificationClient::NotificationClient()
+  : m_queue(std::make_shared<mock::NotificationQueue>())
+{
+}
+
+NotificationClient::~NotificationClient()
+{
+}
+
+bool NotificationClient::Register(const Node &a_node)
+{
+    if (!a_node.IsValid()) {
+        return false;
+    }
+    mock::NodeData &data(*a_node.GetData());
+    {
+        std::lock_guard<std::mutex> l(data.x);
+        data.listeners.push_back(m_queue);
+    }
+    std::lock_guard<std::mutex> l(m_queue->x);
+    m_queue->registered[&data] = a_node;
+    return true;
+}
+
+bool NotificationClient::Unregister(const Node &a_node)
+{
+    std::lock_guard<std::mutex> l(m_queue->x);
+    return m_queue->registered.erase(a_node.GetData().get()) > 0;
+}
+
+bool NotificationClient::GetNotification(NotificationData &a_data,
+    std::chrono::milliseconds a_timeout)
+{
+    std::unique_lock<std::mutex> l(m_queue->x);
+    if (!m_queue->cv.wait_for(l, a_timeout,
+            [this]() { return !m_queue->pending.empty(); })) {
+        return false;
+    }
+    a_data = NotificationData(m_queue->pending.front());
+    m_queue->pending.pop_front();
+    return true;
+}
+
+} // namespace mci
+
+/*******************************************************************************
+ * mock::Instrument
+ */
+namespace mock {
+
+void Notify(NodeData &a_node)
+{
+    std::vector<std::shared_ptr<NotificationQueue> > queues;
+    {
+        std::lock_guard<std::mutex> l(a_node.x);
+        for (auto i = a_node.listeners.begin(); i != a_node.listeners.end(); ) {
+            std::shared_ptr<NotificationQueue> q(i->lock());
+            if (q) {
+                queues.push_back(q);
+                ++i;
+            }
+            else {
+                i = a_node.listeners.erase(i);
+            }
+        }
+    }
+    for (auto i = queues.begin(); i != queues.end(); ++i) {
+        std::lock_guard<std::mutex> l((*i)->x);
+        auto r = (*i)->registered.find(&a_node);
+        if (r != (*i)->registered.end()) {
+            (*i)->pending.push_back(r->second);
+            (*i)->cv.notify_one();
+        }
+    }
+}
+
+Instrument::Instrument(const std::string &a_address)
+  : m_address(a_address),
+    m_up(std::make_shared<std::atomic<bool> >(true)),
+    m_root(std::make_shared<NodeData>("", mci::Path()))
+{
+}
+
+Instrument::~Instrument()
+{
+}
+
+/**
+ * Create an instrument, replacing one with the same address.
+ */
+std::shared_ptr<Instrument> Instrument::Create(const std::string &a_address)
+{
+    std::shared_ptr<Instrument> instrument(new Instrument(a_address));
+    Registry &r(GetRegistry());
+    std::lock_guard<std::mutex> l(r.x);
+    r.instruments[a_address] = instrument;
+    return instrument;
+}
+
+std::shared_ptr<Instrument> Instrument::Find(const std::string &a_address)
+{
+    Registry &r(GetRegistry());
+    std::lock_guard<std::mutex> l(r.x);
+    auto i = r.instruments.find(a_address);
+    return i != r.instruments.end() ? i->second : std::shared_ptr<Instrument>();
+}
+
+void Instrument::Remove(const std::string &a_address)
+{
+    std::shared_ptr<Instrument> instrument(Find(a_address));
+    if (instrument) {
+        instrument->SetUp(false);
+        Registry &r(GetRegistry());
+        std::lock_guard<std::mutex> l(r.x);
+        r.instruments.erase(a_address);
+    }
+}
+
+/**
+ * Node at a_path, created with its parents if it does not exist.
+ */
+std::shared_ptr<NodeData> Instrument::Make(const std::string &a_path)
+{
+    const mci::Path path(mci::Tokenize(a_path));
+    std::shared_ptr<NodeData> node(m_root);
+    for (size_t i(0); i < path.size(); ++i) {
+        auto c = node->index.find(path[i]);
+        if (c == node->index.end()) {
+            std::shared_ptr<NodeData> child(std::make_shared<NodeData>(path[i],
+                mci::Path(path.begin(), path.begin() + i + 1)));
+            node->index[path[i]] = node->children.size();
+            node->children.push_back(child);
+            node = child;
+        }
+        else {
+            node = node->children[c->second];
+        }
+    }
+    return node;
+}
+
+/**
+ * Add a value node, or change the value of an existing node as if it was
+ * changed by the instrument.
+ */
+void Instrument::Store(const std::string &a_path, const mci::Value &a_value,
+    bool a_create)
+{
+    std::shared_ptr<NodeData> node(Make(a_path));
+    {
+        std::lock_guard<std::mutex> l(node->x);
+        if (a_create || node->value.type == mci::eNvUndefined) {
+            node->value = a_value;
+        }
+        else {
+            node->value = Convert(a_value, node->value.type);
+        }
+    }
+    if (!a_create) {
+        Notify(*node);
+    }
+}
+
+void Instrument::AddCommand(const std::string &a_path,
+    const std::function<bool ()> &a_exec)
+{
+    Make(a_path)->exec = a_exec;
+}
+
+void Instrument::AddSignal(const std::string &a_path,
+    const isig::SignalSourceSharedPtr &a_signal)
+{
+    Make(a_path)->signal = a_signal;
+}
+
+void Instrument::SetUp(bool a_up)
+{
+    *m_up = a_up;
+    if (!a_up) {
+        Registry &r(GetRegistry());
+        std::lock_guard<std::mutex> l(r.x);
+        for (auto i = r.sessions.begin(); i != r.sessions.end(); ) {
+            if (i->first.first == m_address) {
+                i->second->open = false;
+                i = r.sessions.erase(i);
+            }
+            else {
+                ++i;
+            }
+        }
+    }
+}
+
+size_t Instrument::GetNodeCount() const
+{
+    return Count(*m_root) - 1;
+}
+
+} // namespace mock
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include <memory>
+
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ > 4)
+    #include <atomic>
+#else
+    #include <cstdatomic>
+#endif
+
+#include <mock/MockInject.h>
+
+namespace mock {
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    // sleeping shorter than this overshoots too much, such waits spin
+    const std::chrono::microseconds c_spinLimit(100);
+
+    std::atomic<int64_t>  s_latencyNs[eCallCount];
+    std::atomic<uint32_t> s_failure[eCallCount]; // probability * 2^32
+    std::atomic<uint64_t> s_calls[eCallCount];
+
+    uint32_t Random()
+    {
+        static thread_local std::minstd_rand random(
+            std::hash<std::thread::id>()(std::this_thread::get_id()));
+        return static_cast<uint32_t>(random() << 1) ^ static_cast<uint32_t>(random());
+    }
+}
+
+void SetLatency(Call_e a_call, std::chrono::nanoseconds a_latency)
+{
+    s_latencyNs[a_call] = a_latency.count();
+}
+
+void SetFailureRate(Call_e a_call, double a_probability)
+{
+    const double p(std::min(std::max(a_probability, 0.0), 1.0));
+    s_failure[a_call] = p >= 1.0 ? UINT32_MAX : static_cast<uint32_t>(p * 4294967296.0);
+}
+
+void ResetInjection()
+{
+    for (size_t i(0); i < eCallCount; ++i) {
+        s_latencyNs[i] = 0;
+        s_failure[i] = 0;
+        s_calls[i] = 0;
+    }
+}
+
+uint64_t GetCallCount(Call_e a_call)
+{
+    return s_calls[a_call];
+}
+
+void WaitUntil(Clock::time_point a_deadline)
+{
+    Clock::time_point now(Clock::now());
+    if (a_deadline - now > c_spinLimit) {
+        std::this_thread::sleep_until(a_deadline - c_spinLimit);
+    }
+    while (Clock::now() < a_deadline) {
+    }
+}
+
+bool Inject(Call_e a_call)
+{
+    s_calls[a_call].fetch_add(1, std::memory_order_relaxed);
+    const int64_t ns(s_latencyNs[a_call].load(std::memory_order_relaxed));
+    if (ns > 0) {
+        WaitUntil(Clock::now() + std::chrono::nanoseconds(ns));
+    }
+    const uint32_t failure(s_failure[a_call].load(std::memory_order_relaxed));
+    return failure != 0 && Random() < failure;
+}
+
+Generator Sine(double a_amplitude, double a_periodAtoms, double a_noise)
+{
+    std::shared_ptr<std::minstd_rand> generator(std::make_shared<std::minstd_rand>(1));
+    return [a_amplitude, a_periodAtoms, a_noise, generator](size_t a_component, uint64_t a_atom) {
+        const double phase(2 * M_PI * (a_atom / a_periodAtoms + a_component / 4.0));
+        std::uniform_real_distribution<double> noise(-a_noise, a_noise);
+        return a_amplitude * std::sin(phase) + (a_noise > 0 ? noise(*generator) : 0);
+    };
+}
+
+Generator Ramp(double a_step)
+{
+    return [a_step](size_t a_component, uint64_t a_atom) {
+        return a_step * a_atom + a_component;
+    };
+}
+
+} // namespace mock
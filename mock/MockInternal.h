@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_INTERNAL_H
+#define MOCK_INTERNAL_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <mci/node.h>
+#include <isig/signal_source.h>
+
+namespace mock {
+
+struct NotificationQueue;
+
+/**
+ * Registry node of a mock instrument. The tree structure is built before
+ * connecting and not changed afterwards, values are guarded by the node
+ * mutex.
+ */
+struct NodeData {
+    NodeData(const std::string &a_name, const mci::Path &a_path)
+      : name(a_name),
+        path(a_path)
+    {
+    }
+
+    const std::string                        name;
+    const mci::Path                          path; // relative to the root
+    std::vector<std::shared_ptr<NodeData> >  children;
+    std::unordered_map<std::string, size_t>  index; // child by name
+
+    std::mutex                               x;
+    mci::Value                               value;
+    std::function<bool ()>                   exec;
+    isig::SignalSourceSharedPtr              signal;
+    std::vector<std::weak_ptr<NotificationQueue> > listeners;
+};
+
+/**
+ * One mci connection to an instrument, closed on disconnect or when the
+ * instrument goes down.
+ */
+struct Session {
+    Session(const std::string &a_address, mci::Root a_type,
+        const std::shared_ptr<const std::atomic<bool> > &a_up)
+      : address(a_address),
+        type(a_type),
+        up(a_up),
+        open(true)
+    {
+    }
+
+    bool IsOpen() const { return open && up->load(); }
+
+    const std::string                           address;
+    const mci::Root                             type;
+    const std::shared_ptr<const std::atomic<bool> > up;
+    std::atomic<bool>                           open;
+};
+
+/**
+ * Pending notifications of one notification client.
+ */
+struct NotificationQueue {
+    std::mutex                            x;
+    std::condition_variable               cv;
+    std::deque<mci::Node>                 pending;
+    std::map<const NodeData *, mci::Node> registered;
+};
+
+/**
+ * Queue notification for all clients registered to the node.
+ */
+void Notify(NodeData &a_node);
+
+} // namespace mock
+
+#endif //MOCK_INTERNAL_H
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_ISIG_DATA_ON_DEMAND_REMOTE_SOURCE_H
+#define MOCK_ISIG_DATA_ON_DEMAND_REMOTE_SOURCE_H
+
+#include <chrono>
+#include <string>
+
+#include <isig/signal_traits.h>
+#include <mock/MockInject.h>
+
+namespace isig {
+
+/*******************************************************************************
+ * Mock data on demand source. Triggers occur with a fixed period, event
+ * modes wait for the next trigger while eModeDodNow returns immediately.
+ */
+template <class Traits>
+class DataOnDemandRemoteSource : public SignalSource {
+public:
+    typedef typename Traits::BaseType BaseType;
+    typedef mock::Waveform<BaseType>  Wave;
+    typedef std::chrono::steady_clock Clock;
+
+    DataOnDemandRemoteSource(const std::shared_ptr<const Wave> &a_wave,
+        Clock::duration a_triggerPeriod, const UpFlag &a_up)
+      : SignalSource(eAccessDataOnDemand, a_up),
+        m_wave(a_wave),
+        m_period(a_triggerPeriod),
+        m_epoch(Clock::now())
+    {
+    }
+
+    Traits GetTraits() const { return Traits(); }
+
+    class Client {
+    public:
+        Client(const std::shared_ptr<DataOnDemandRemoteSource> &a_source,
+            const std::string &, Traits)
+          : m_source(a_source),
+            m_open(false),
+            m_mode(eModeDodNow),
+            m_offset(0),
+            m_trigger(0)
+        {
+        }
+
+        bool IsOpen() const { return m_open; }
+
+        SuccessCode_e Open(AccessMode_e a_mode, size_t, size_t a_offset)
+        {
+            if (mock::Inject(mock::eCallDodOpen) || !m_source->IsUp()) {
+                return eFail;
+            }
+            m_open = true;
+            m_mode = a_mode;
+            m_offset = a_offset;
+            m_trigger = m_source->LastTrigger();
+            return eSuccess;
+        }
+
+        void Close() { m_open = false; }
+
+        Array<Traits> CreateBuffer(size_t a_length)
+        {
+            return Array<Traits>(a_length, m_source->m_wave->components);
+        }
+
+        SuccessCode_e Read(Array<Traits> &a_buf, SignalMeta &a_meta, int32_t a_offset)
+        {
+            if (!m_open || mock::Inject(mock::eCallDodRead) || !m_source->IsUp()) {
+                return eFail;
+            }
+            if (m_mode != eModeDodNow && m_source->m_period.count() > 0) {
+                // wait for a trigger after the last one read
+                m_source->WaitTrigger(m_trigger + 1);
+            }
+            m_trigger = m_source->LastTrigger();
+            a_meta.id = m_trigger;
+            m_source->m_wave->Fill(a_buf,
+                m_trigger * a_buf.GetLength() + m_offset + a_offset, a_buf.GetLength());
+            if (m_mode == eModeDodSingleEvent) {
+                m_open = false;
+            }
+            return eSuccess;
+        }
+
+    private:
+        std::shared_ptr<DataOnDemandRemoteSource> m_source;
+        bool         m_open;
+        AccessMode_e m_mode;
+        size_t       m_offset;
+        uint64_t     m_trigger; // last trigger read
+    };
+
+private:
+    uint64_t LastTrigger() const
+    {
+        if (m_period.count() <= 0) {
+            return 0;
+        }
+        return (Clock::now() - m_epoch) / m_period;
+    }
+
+    void WaitTrigger(uint64_t a_trigger) const
+    {
+        mock::WaitUntil(m_epoch + m_period * a_trigger);
+    }
+
+    std::shared_ptr<const Wave> m_wave;
+    Clock::duration             m_period;
+    Clock::time_point           m_epoch; // time of trigger 0
+};
+
+} // namespace isig
+
+#endif //MOCK_ISIG_DATA_ON_DEMAND_REMOTE_SOURCE_H
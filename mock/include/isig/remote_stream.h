@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_ISIG_REMOTE_STREAM_H
+#define MOCK_ISIG_REMOTE_STREAM_H
+
+#include <chrono>
+#include <string>
+
+#include <isig/signal_traits.h>
+#include <mock/MockInject.h>
+
+namespace isig {
+
+/*******************************************************************************
+ * Mock stream, atoms are produced at a fixed rate from the start of each
+ * client session and read from a precomputed waveform.
+ */
+template <class Traits>
+class RemoteStream : public SignalSource {
+public:
+    typedef typename Traits::BaseType          BaseType;
+    typedef mock::Waveform<BaseType>           Wave;
+    typedef std::chrono::steady_clock          Clock;
+
+    RemoteStream(const std::shared_ptr<const Wave> &a_wave,
+        double a_atomsPerSecond, const UpFlag &a_up)
+      : SignalSource(eAccessStream, a_up),
+        m_wave(a_wave),
+        m_rate(a_atomsPerSecond)
+    {
+    }
+
+    class Client {
+    public:
+        Client(RemoteStream *a_stream, const std::string &)
+          : m_stream(a_stream),
+            m_open(false),
+            m_atom(0)
+        {
+        }
+
+        bool IsOpen() const { return m_open; }
+
+        SuccessCode_e Open()
+        {
+            if (!m_stream->IsUp()) {
+                return eFail;
+            }
+            m_open = true;
+            m_start = Clock::now();
+            m_atom = 0;
+            return eSuccess;
+        }
+
+        void Close() { m_open = false; }
+
+        Array<Traits> CreateBuffer(size_t a_length)
+        {
+            return Array<Traits>(a_length, m_stream->m_wave->components);
+        }
+
+        /**
+         * Blocks until the last atom of the buffer has been produced.
+         */
+        SuccessCode_e Read(Array<Traits> &a_buf)
+        {
+            if (!m_open || mock::Inject(mock::eCallStreamRead) || !m_stream->IsUp()) {
+                return eFail;
+            }
+            const size_t count(a_buf.GetLength());
+            if (m_stream->m_rate > 0) {
+                mock::WaitUntil(m_start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>((m_atom + count) / m_stream->m_rate)));
+            }
+            m_stream->m_wave->Fill(a_buf, m_atom, count);
+            m_atom += count;
+            return eSuccess;
+        }
+
+    private:
+        RemoteStream     *m_stream;
+        bool              m_open;
+        Clock::time_point m_start;
+        uint64_t          m_atom; // atoms read in this session
+    };
+
+private:
+    std::shared_ptr<const Wave> m_wave;
+    double                      m_rate;
+};
+
+} // namespace isig
+
+#endif //MOCK_ISIG_REMOTE_STREAM_H
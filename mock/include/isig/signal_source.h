@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_ISIG_SIGNAL_SOURCE_H
+#define MOCK_ISIG_SIGNAL_SOURCE_H
+
+/*
+ * Mock of the isig signal source subset used by the library.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ > 4)
+    #include <atomic>
+#else
+    #include <cstdatomic>
+#endif
+
+namespace isig {
+
+enum AccessMode_e {
+    eModeDodNow,
+    eModeDodOnEvent,
+    eModeDodSingleEvent
+};
+
+enum AccessType_e {
+    eAccessStream,
+    eAccessDataOnDemand
+};
+
+enum SuccessCode_e {
+    eSuccess,
+    eFail
+};
+
+struct SignalMeta {
+    SignalMeta() : id(0) {}
+    uint64_t id; // trigger sequence number
+};
+
+/**
+ * Base of mock signal sources, reads fail while the instrument is down.
+ */
+class SignalSource {
+public:
+    typedef std::shared_ptr<const std::atomic<bool> > UpFlag;
+
+    SignalSource(AccessType_e a_type, const UpFlag &a_up)
+      : m_type(a_type),
+        m_up(a_up)
+    {
+    }
+    virtual ~SignalSource() {}
+
+    AccessType_e AccessType() const { return m_type; }
+    bool IsUp() const { return !m_up || m_up->load(); }
+
+private:
+    AccessType_e m_type;
+    UpFlag       m_up;
+};
+
+typedef std::shared_ptr<SignalSource> SignalSourceSharedPtr;
+
+} // namespace isig
+
+#endif //MOCK_ISIG_SIGNAL_SOURCE_H
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_ISIG_SIGNAL_TRAITS_H
+#define MOCK_ISIG_SIGNAL_TRAITS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <isig/signal_source.h>
+
+namespace isig {
+
+struct SignalTraitsVarInt32 {
+    typedef int32_t BaseType;
+};
+
+struct SignalTraitsVarInt16 {
+    typedef int16_t BaseType;
+};
+
+/**
+ * Signal buffer of atoms, each atom a row of components stored
+ * contiguously.
+ */
+template <class Traits>
+class Array {
+public:
+    typedef typename Traits::BaseType BaseType;
+
+    explicit Array(size_t a_length = 0, size_t a_components = 1)
+      : m_components(a_components),
+        m_length(a_length),
+        m_data(a_length * a_components)
+    {
+    }
+
+    size_t GetLength() const { return m_length; }
+    size_t GetComponents() const { return m_components; }
+
+    void Resize(size_t a_length)
+    {
+        m_length = a_length;
+        m_data.resize(a_length * m_components);
+    }
+
+    BaseType *operator[](size_t a_atom) { return &m_data[a_atom * m_components]; }
+    const BaseType *operator[](size_t a_atom) const { return &m_data[a_atom * m_components]; }
+
+private:
+    size_t                m_components;
+    size_t                m_length;
+    std::vector<BaseType> m_data;
+};
+
+} // namespace isig
+
+#endif //MOCK_ISIG_SIGNAL_TRAITS_H
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_ISTD_TRACE_H
+#define MOCK_ISTD_TRACE_H
+
+/*
+ * Mock of the istd trace and exception subset used by the library.
+ * Tracing is compiled out, so benchmarks measure the code without it.
+ */
+
+#include <stdexcept>
+#include <sstream>
+#include <string>
+
+namespace istd {
+
+enum TraceLevel_e {
+    eTrcOff,
+    eTrcLow,
+    eTrcMed,
+    eTrcHigh,
+    eTrcDetail
+};
+
+class Exception : public std::runtime_error {
+public:
+    explicit Exception(const std::string &a_what) : std::runtime_error(a_what) {}
+};
+
+} // namespace istd
+
+#define istd_FTRC() do {} while (0)
+#define istd_TRC(a_level, a_msg) do {} while (0)
+#define istd_EXCEPTION(a_msg) \
+    do { \
+        std::ostringstream istd_ss; \
+        istd_ss << a_msg; \
+        throw istd::Exception(istd_ss.str()); \
+    } while (0)
+
+#endif //MOCK_ISTD_TRACE_H
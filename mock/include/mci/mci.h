@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_MCI_MCI_H
+#define MOCK_MCI_MCI_H
+
+/*
+ * Mock of the mci connection functions. Connections are made to
+ * instruments created with mock::Instrument::Create.
+ */
+
+#include <mci/node.h>
+
+namespace mci {
+
+Node Connect(const char *a_address, Root a_root);
+void Disconnect(const char *a_address, Root a_root);
+Node GetNode(const char *a_address, Root a_root);
+ConnectionState Ping(const Node &a_node);
+
+} // namespace mci
+
+#endif //MOCK_MCI_MCI_H
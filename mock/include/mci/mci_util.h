@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_MCI_UTIL_H
+#define MOCK_MCI_UTIL_H
+
+#include <mci/node.h>
+#include <isig/signal_source.h>
+
+namespace mci {
+
+/**
+ * Signal source attached to the node with mock::Instrument::AddSignal.
+ */
+isig::SignalSourceSharedPtr CreateRemoteSignal(const Node &a_node);
+
+} // namespace mci
+
+#endif //MOCK_MCI_UTIL_H
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_MCI_NODE_H
+#define MOCK_MCI_NODE_H
+
+/*
+ * Mock of the mci::Node subset used by the library, backed by the
+ * simulated registry of mock::Instrument.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+
+#include <istd/trace.h>
+
+namespace mock {
+    struct NodeData;
+    struct Session;
+}
+
+namespace mci {
+
+typedef std::vector<std::string> Path;
+
+enum NodeValueType {
+    eNvUndefined,
+    eNvBool,
+    eNvLong,
+    eNvULong,
+    eNvLongLong,
+    eNvULongLong,
+    eNvDouble,
+    eNvString
+};
+
+enum class Root {
+    Application,
+    Platform
+};
+
+enum ConnectionState {
+    Disconnected,
+    Connected
+};
+
+/**
+ * Registry value, numbers are kept in the widest type of their kind.
+ * Array values keep their elements in array, scalar fields hold the
+ * first element.
+ */
+struct Value {
+    Value() : type(eNvUndefined), i(0), u(0), d(0) {}
+
+    NodeValueType type;
+    int64_t       i;
+    uint64_t      u;
+    double        d;
+    std::string   s;
+    std::vector<double> array;
+
+    template <typename T>
+    T As() const
+    {
+        switch (type) {
+        case eNvBool:
+        case eNvLong:
+        case eNvLongLong:
+            return static_cast<T>(i);
+        case eNvULong:
+        case eNvULongLong:
+            return static_cast<T>(u);
+        case eNvDouble:
+            return static_cast<T>(d);
+        case eNvString: {
+            std::istringstream ss(s);
+            double v(0);
+            ss >> v;
+            return static_cast<T>(v);
+        }
+        default:
+            return T();
+        }
+    }
+
+    template <typename T>
+    static Value From(const T &a_val)
+    {
+        Value v;
+        if (std::is_same<T, bool>::value) {
+            v.type = eNvBool;
+        }
+        else if (std::is_floating_point<T>::value) {
+            v.type = eNvDouble;
+        }
+        else if (std::is_signed<T>::value) {
+            v.type = sizeof(T) > 4 ? eNvLongLong : eNvLong;
+        }
+        else {
+            v.type = sizeof(T) > 4 ? eNvULongLong : eNvULong;
+        }
+        v.i = static_cast<int64_t>(a_val);
+        v.u = static_cast<uint64_t>(a_val);
+        v.d = static_cast<double>(a_val);
+        return v;
+    }
+
+    template <typename T>
+    static Value From(const std::vector<T> &a_val)
+    {
+        Value v(From(a_val.empty() ? T() : a_val[0]));
+        v.array.assign(a_val.begin(), a_val.end());
+        return v;
+    }
+
+    std::string ToString() const;
+};
+
+/*******************************************************************************
+ * Handle of a registry node within one connection. Access fails with an
+ * exception once the connection is closed or the instrument is down.
+ */
+class Node {
+public:
+    Node();
+    Node(const std::shared_ptr<mock::NodeData> &a_data,
+        const std::shared_ptr<mock::Session> &a_session);
+
+    bool IsValid() const;
+    void Destroy();
+
+    Node GetNode(const Path &a_path) const;
+    Node GetNode(size_t a_index) const;
+    size_t GetNodeCount() const;
+
+    template <typename T>
+    bool Get(T &a_val) const
+    {
+        Value v;
+        Read(v);
+        a_val = v.As<T>();
+        return true;
+    }
+
+    template <typename T>
+    bool Get(std::vector<T> &a_val) const
+    {
+        Value v;
+        Read(v);
+        a_val.resize(v.array.size());
+        for (size_t i(0); i < v.array.size(); ++i) {
+            a_val[i] = static_cast<T>(v.array[i]);
+        }
+        return true;
+    }
+
+    bool Get(std::string &a_val) const
+    {
+        Value v;
+        Read(v);
+        a_val = v.ToString();
+        return true;
+    }
+
+    template <typename T>
+    bool Set(const T &a_val)
+    {
+        Write(Value::From(a_val));
+        return true;
+    }
+
+    bool Set(const std::string &a_val)
+    {
+        Value v;
+        v.type = eNvString;
+        v.s = a_val;
+        Write(v);
+        return true;
+    }
+
+    bool Execute();
+
+    Path GetRelPath() const;
+    Path GetFullPath() const;
+    std::string GetName() const;
+    NodeValueType GetValueType() const;
+    bool IsReadable() const;
+    std::string ToString(size_t a_index) const;
+
+    bool operator==(const Node &a_other) const { return m_data == a_other.m_data; }
+    bool operator!=(const Node &a_other) const { return m_data != a_other.m_data; }
+
+    const std::shared_ptr<mock::NodeData> &GetData() const { return m_data; }
+    const std::shared_ptr<mock::Session> &GetSession() const { return m_session; }
+
+private:
+    void Check() const;
+    void Read(Value &a_val) const;
+    void Write(const Value &a_val);
+
+    std::shared_ptr<mock::NodeData> m_data;
+    std::shared_ptr<mock::Session>  m_session;
+};
+
+Path Tokenize(const std::string &a_path);
+std::string ToString(const Path &a_path);
+
+} // namespace mci
+
+#endif //MOCK_MCI_NODE_H
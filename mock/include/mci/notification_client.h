@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_MCI_NOTIFICATION_CLIENT_H
+#define MOCK_MCI_NOTIFICATION_CLIENT_H
+
+#include <chrono>
+#include <memory>
+
+#include <mci/node.h>
+#include <mci/notification_data.h>
+
+namespace mock {
+    struct NotificationQueue;
+}
+
+namespace mci {
+
+/**
+ * Receives a notification for each value change of a registered node.
+ */
+class NotificationClient {
+public:
+    NotificationClient();
+    ~NotificationClient();
+
+    bool Register(const Node &a_node);
+    bool Unregister(const Node &a_node);
+    bool GetNotification(NotificationData &a_data, std::chrono::milliseconds a_timeout);
+
+private:
+    NotificationClient(const NotificationClient &);
+    NotificationClient &operator=(const NotificationClient &);
+
+    std::shared_ptr<mock::NotificationQueue> m_queue;
+};
+
+} // namespace mci
+
+#endif //MOCK_MCI_NOTIFICATION_CLIENT_H
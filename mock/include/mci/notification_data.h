@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_MCI_NOTIFICATION_DATA_H
+#define MOCK_MCI_NOTIFICATION_DATA_H
+
+#include <mci/node.h>
+
+namespace mci {
+
+class NotificationData {
+public:
+    NotificationData() {}
+    explicit NotificationData(const Node &a_node) : m_node(a_node) {}
+
+    Node GetNode() const { return m_node; }
+
+private:
+    Node m_node;
+};
+
+} // namespace mci
+
+#endif //MOCK_MCI_NOTIFICATION_DATA_H
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_BACKEND_H
+#define MOCK_BACKEND_H
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <chrono>
+
+#include <mci/node.h>
+#include <isig/remote_stream.h>
+#include <isig/data_on_demand_remote_source.h>
+#include <mock/MockInject.h>
+
+namespace mock {
+
+/*******************************************************************************
+ * Simulated instrument, reachable with mci::Connect at its address once
+ * created. The registry is built with Add* methods, intermediate nodes
+ * are created as needed. Value changes made with Set are notified to
+ * registered notification clients, same as writes through mci::Node.
+ */
+class Instrument {
+public:
+    static std::shared_ptr<Instrument> Create(const std::string &a_address);
+    static std::shared_ptr<Instrument> Find(const std::string &a_address);
+    static void Remove(const std::string &a_address);
+
+    ~Instrument();
+
+    template <typename T>
+    void Add(const std::string &a_path, const T &a_value)
+    {
+        Store(a_path, mci::Value::From(a_value), true);
+    }
+
+    template <typename T>
+    void Set(const std::string &a_path, const T &a_value)
+    {
+        Store(a_path, mci::Value::From(a_value), false);
+    }
+
+    void AddCommand(const std::string &a_path, const std::function<bool ()> &a_exec);
+    void AddSignal(const std::string &a_path, const isig::SignalSourceSharedPtr &a_signal);
+
+    /**
+     * Add a stream signal producing a_atomsPerSecond atoms of a_components,
+     * computed once for a table of a_atoms.
+     */
+    template <typename Traits>
+    void AddStream(const std::string &a_path, size_t a_components,
+        const Generator &a_gen, double a_atomsPerSecond, size_t a_atoms = 65536)
+    {
+        typedef isig::RemoteStream<Traits> Stream;
+        AddSignal(a_path, std::make_shared<Stream>(
+            std::make_shared<typename Stream::Wave>(a_components, a_atoms, a_gen),
+            a_atomsPerSecond, m_up));
+    }
+
+    /**
+     * Add a data on demand signal triggered every a_triggerPeriod.
+     */
+    template <typename Traits>
+    void AddDod(const std::string &a_path, size_t a_components,
+        const Generator &a_gen, std::chrono::steady_clock::duration a_triggerPeriod,
+        size_t a_atoms = 65536)
+    {
+        typedef isig::DataOnDemandRemoteSource<Traits> Source;
+        AddSignal(a_path, std::make_shared<Source>(
+            std::make_shared<typename Source::Wave>(a_components, a_atoms, a_gen),
+            a_triggerPeriod, m_up));
+    }
+
+    /**
+     * Switch the instrument off or on. Switching off closes all
+     * connections, as a reboot does, and new ones fail until it is on.
+     */
+    void SetUp(bool a_up);
+    bool IsUp() const { return m_up->load(); }
+
+    const std::string &GetAddress() const { return m_address; }
+    const std::shared_ptr<NodeData> &GetRoot() const { return m_root; }
+    const std::shared_ptr<std::atomic<bool> > &GetUpFlag() const { return m_up; }
+    size_t GetNodeCount() const;
+
+private:
+    explicit Instrument(const std::string &a_address);
+    Instrument(const Instrument &);
+    Instrument &operator=(const Instrument &);
+
+    void Store(const std::string &a_path, const mci::Value &a_value, bool a_create);
+    std::shared_ptr<NodeData> Make(const std::string &a_path);
+
+    const std::string                   m_address;
+    std::shared_ptr<std::atomic<bool> > m_up;
+    std::shared_ptr<NodeData>           m_root;
+};
+
+} // namespace mock
+
+#endif //MOCK_BACKEND_H
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef MOCK_INJECT_H
+#define MOCK_INJECT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <functional>
+#include <limits>
+#include <algorithm>
+
+/**
+ * Latency and failure injection of the mock backend. Every instrumented
+ * call first waits for the configured latency and then fails with the
+ * configured probability.
+ */
+namespace mock {
+
+enum Call_e {
+    eCallConnect,    // mci::Connect
+    eCallPing,       // mci::Ping
+    eCallGet,        // mci::Node::Get
+    eCallSet,        // mci::Node::Set
+    eCallExecute,    // mci::Node::Execute
+    eCallStreamRead, // isig stream client Read
+    eCallDodOpen,    // isig data on demand client Open
+    eCallDodRead,    // isig data on demand client Read
+    eCallCount
+};
+
+void SetLatency(Call_e a_call, std::chrono::nanoseconds a_latency);
+void SetFailureRate(Call_e a_call, double a_probability);
+void ResetInjection();
+uint64_t GetCallCount(Call_e a_call);
+
+/**
+ * Apply injected latency, returns true if the call has to fail.
+ */
+bool Inject(Call_e a_call);
+
+/**
+ * Wait until given time, spinning for short waits which sleep would
+ * overshoot.
+ */
+void WaitUntil(std::chrono::steady_clock::time_point a_deadline);
+
+/**
+ * Synthetic signal value of a component at given atom index.
+ */
+typedef std::function<double (size_t a_component, uint64_t a_atom)> Generator;
+
+Generator Sine(double a_amplitude, double a_periodAtoms, double a_noise = 0);
+Generator Ramp(double a_step = 1);
+
+/**
+ * Precomputed signal table, read cyclically by the signal clients so that
+ * generating data costs no more than a copy.
+ */
+template <typename T>
+struct Waveform {
+    Waveform(size_t a_components, size_t a_atoms, const Generator &a_gen)
+      : components(a_components),
+        atoms(a_atoms),
+        data(a_components * a_atoms)
+    {
+        for (size_t a(0); a < a_atoms; ++a) {
+            for (size_t c(0); c < a_components; ++c) {
+                // saturate, the conversion is undefined out of range
+                const double v(std::min<double>(std::max<double>(a_gen(c, a),
+                    std::numeric_limits<T>::lowest()), std::numeric_limits<T>::max()));
+                data[a * a_components + c] = static_cast<T>(v);
+            }
+        }
+    }
+
+    /**
+     * Copy a_count atoms starting at a_atom into a_dst rows.
+     */
+    template <typename Buffer>
+    void Fill(Buffer &a_dst, uint64_t a_atom, size_t a_count) const
+    {
+        for (size_t r(0); r < a_count; ++r) {
+            const T *src(&data[((a_atom + r) % atoms) * components]);
+            T *dst(a_dst[r]);
+            for (size_t c(0); c < components; ++c) {
+                dst[c] = src[c];
+            }
+        }
+    }
+
+    size_t         components;
+    size_t         atoms;
+    std::vector<T> data;
+};
+
+} // namespace mock
+
+#endif //MOCK_INJECT_H
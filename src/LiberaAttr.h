@@ -18,6 +18,15 @@
 #include <mci/mci.h>
 #include <mci/node.h>
 
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ > 4)
+    #include <atomic>
+#else
+    #include <cstdatomic>
+#endif
+
+#include "LiberaNodes.h"
+#include "LiberaLatency.h"
+
 class LiberaClient;
 
 /*******************************************************************************
@@ -25,55 +34,95 @@ class LiberaClient;
  */
 class LiberaAttr {
 public:
-    LiberaAttr() : m_client(NULL) {}
+    /**
+     * State of registry change notification for the attribute node.
+     */
+    enum Subscription_e {
+        eSubNone,        // polled, subscription not tried yet
+        eSubActive,      // updated on notification, not polled
+        eSubUnsupported  // polled, node doesn't support notification
+    };
+
+    LiberaAttr() : m_client(NULL), m_subscription(eSubNone) {}
     virtual ~LiberaAttr() {};
     void EnableNotify(LiberaClient *a_client) { m_client = a_client; }
     void Notify();
-    virtual void Read(mci::Node &a_root) = 0;
+    virtual void Read() = 0;
+    /**
+     * Two phase read used by bulk polling: Fetch gets the value from the
+     * registry and may run concurrently with other attributes, Apply then
+     * stores it and notifies from the polling thread.
+     */
+    virtual void Fetch() {}
+    virtual void Apply() { Read(); }
+    /**
+     * Drop a fetched value that will not be applied, called when the poll
+     * cycle fails.
+     */
+    virtual void Discard() {}
     /**
-     * This methods check for given attribute handle and are implemented
-     * in derived class. All has default implementation here because if the type
-     * doesn't match also the handle does not.
+     * Resolve cached node handles on (re)connection. Attributes without
+     * registry nodes don't need to implement it.
      */
-    virtual bool IsEqual(Tango::DevDouble *&) { return false; }
-    virtual bool IsEqual(Tango::DevLong *&) { return false; }
-    virtual bool IsEqual(Tango::DevULong *&) { return false; }
-    virtual bool IsEqual(Tango::DevShort *&) { return false; }
-    virtual bool IsEqual(Tango::DevUShort *&) { return false; }
-    virtual bool IsEqual(Tango::DevBoolean *&) { return false; }
+    virtual void Resolve(mci::Node &) {}
+    virtual void Invalidate() {}
+    /**
+     * Perform pending asynchronous write, called from the write queue.
+     */
+    virtual void Flush() {}
+    /**
+     * Node whose change notification can replace polling of the attribute.
+     * Attributes not mapped to exactly one node return an invalid node.
+     */
+    virtual mci::Node GetNotifyNode() { return mci::Node(); }
+    /**
+     * Registry path reported with the latency histograms, empty for
+     * attributes not read from a single path.
+     */
+    virtual const std::string &GetName() const {
+        static const std::string none;
+        return none;
+    }
+    LiberaLatency &GetReadLatency() { return m_readLatency; }
+    LiberaLatency &GetWriteLatency() { return m_writeLatency; }
+
+    Subscription_e GetSubscription() const { return m_subscription; }
+    void SetSubscription(Subscription_e a_sub) { m_subscription = a_sub; }
     /**
      *  Reader and writer functions for specific attribute handling implement
      *  type conversion, combining of several ireg nodes, etc...
+     *  Node handles are taken from the attribute's cache, sub-nodes are
+     *  addressed with the suffix appended to the attribute path.
      */
-    static Tango::DevDouble NM2MM(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevDouble NM2MM(LiberaNodes &a_nodes) {
         istd_FTRC();
         int32_t val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val / 1e6;
     }
-    static void MM2NM(mci::Node &a_root, const std::string &a_path, const Tango::DevDouble a_val) {
+    static void MM2NM(LiberaNodes &a_nodes, const Tango::DevDouble a_val) {
         istd_FTRC();
         int32_t val = a_val * 1e6;
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        a_nodes.Get().Set(val);
     }
-    static Tango::DevDouble K2MM(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevDouble K2MM(LiberaNodes &a_nodes) {
         istd_FTRC();
         uint32_t val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val / 1e7;
     }
-    static void MM2K(mci::Node &a_root, const std::string &a_path, const Tango::DevDouble a_val) {
+    static void MM2K(LiberaNodes &a_nodes, const Tango::DevDouble a_val) {
         istd_FTRC();
         uint32_t val = a_val * 1e7;
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        a_nodes.Get().Set(val);
     }
-    static Tango::DevDouble INT2DBL(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevDouble INT2DBL(LiberaNodes &a_nodes) {
         istd_FTRC();
         int32_t val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val;
     }
-    static void DBL2INT(mci::Node &a_root, const std::string &a_path, const Tango::DevDouble a_val) {
+    static void DBL2INT(LiberaNodes &a_nodes, const Tango::DevDouble a_val) {
         istd_FTRC();
         int32_t val;
         if (a_val < LONG_MIN) {
@@ -87,69 +136,69 @@ public:
                 val = a_val;
             }
         }
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        a_nodes.Get().Set(val);
     }
-    static Tango::DevLong ULONG2LONG(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevLong ULONG2LONG(LiberaNodes &a_nodes) {
         istd_FTRC();
         uint32_t val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val < LONG_MAX ? val : LONG_MAX;
     }
-    static void LONG2ULONG(mci::Node &a_root, const std::string &a_path, const Tango::DevLong a_val) {
+    static void LONG2ULONG(LiberaNodes &a_nodes, const Tango::DevLong a_val) {
         istd_FTRC();
         uint32_t val = a_val > 0 ? a_val : 0;
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        a_nodes.Get().Set(val);
     }
-    static Tango::DevLong ULL2LONG(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevLong ULL2LONG(LiberaNodes &a_nodes) {
         istd_FTRC();
         uint64_t val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val;
     }
-    static Tango::DevShort ULL2SHORT(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevShort ULL2SHORT(LiberaNodes &a_nodes) {
         istd_FTRC();
         uint64_t val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val & 0x0000ffff;
     }
-    static Tango::DevDouble ULL2DBL(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevDouble ULL2DBL(LiberaNodes &a_nodes) {
         istd_FTRC();
         uint64_t val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val;
     }
-    static void DBL2ULL(mci::Node &a_root, const std::string &a_path, const Tango::DevDouble a_val) {
+    static void DBL2ULL(LiberaNodes &a_nodes, const Tango::DevDouble a_val) {
         istd_FTRC();
         uint64_t val = a_val;
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        a_nodes.Get().Set(val);
     }
     /**
      * reader and writer for negated bool value
      */
-    static Tango::DevBoolean NEGATE(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevBoolean NEGATE(LiberaNodes &a_nodes) {
         istd_FTRC();
         bool val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return !val;
     }
-    static void NEGATE(mci::Node &a_root, const std::string &a_path, const Tango::DevBoolean a_val) {
+    static void NEGATE(LiberaNodes &a_nodes, const Tango::DevBoolean a_val) {
         istd_FTRC();
         bool val(!a_val);
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        a_nodes.Get().Set(val);
     }
     /**
      * conversion for firsts enum 0 => false, other => true
      */
-    static Tango::DevBoolean ENUM2BOOL(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevBoolean ENUM2BOOL(LiberaNodes &a_nodes) {
         istd_FTRC();
         int64_t val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val;
     }
-    static void BOOL2ENUM(mci::Node &a_root, const std::string &a_path, const Tango::DevBoolean a_val) {
+    static void BOOL2ENUM(LiberaNodes &a_nodes, const Tango::DevBoolean a_val) {
         istd_FTRC();
         int64_t val(a_val);
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        a_nodes.Get().Set(val);
     }
     /**
      * DSCMode specific conversion for adjust and type subnodes.
@@ -159,15 +208,15 @@ public:
      */
 
     //TODO create 8 combinations of 3 nodes (Switching, Adjust, Type) see Manual 2.4.3.4 Table 4
-    static Tango::DevShort DSC2SHORT(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevShort DSC2SHORT(LiberaNodes &a_nodes) {
         istd_FTRC();
         bool enabled;
         Tango::DevShort res(0);
-        a_root.GetNode(mci::Tokenize(a_path + ".adjust")).Get(enabled);
+        a_nodes.Get(".adjust").Get(enabled);
         if (enabled) {
             res = 1;
             int64_t type;
-            a_root.GetNode(mci::Tokenize(a_path+".type")).Get(type);
+            a_nodes.Get(".type").Get(type);
             if (type != 0) {
                 res = 2;
             }
@@ -175,102 +224,107 @@ public:
         return res;
     }
 
-    static void SHORT2DSC(mci::Node &a_root, const std::string &a_path, const Tango::DevShort a_val) {
+    static void SHORT2DSC(LiberaNodes &a_nodes, const Tango::DevShort a_val) {
         istd_FTRC();
         bool enabled(a_val != 0);
-        a_root.GetNode(mci::Tokenize(a_path+".adjust")).Set(enabled);
+        a_nodes.Get(".adjust").Set(enabled);
         int64_t type(!(a_val == 1) ? 0 : 1);
-        a_root.GetNode(mci::Tokenize(a_path+".type")).Set(type);
+        a_nodes.Get(".type").Set(type);
     }
 
-    static Tango::DevShort FAN2SHORT(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevShort FAN2SHORT(LiberaNodes &a_nodes) {
         istd_FTRC();
         double min;
-        a_root.GetNode(mci::Tokenize(a_path + "front")).Get(min);
+        a_nodes.Get("front").Get(min);
         double val;
-        a_root.GetNode(mci::Tokenize(a_path + "middle")).Get(val);
+        a_nodes.Get("middle").Get(val);
         if (val < min) {
             min = val;
         }
-        a_root.GetNode(mci::Tokenize(a_path + "rear")).Get(val);
+        a_nodes.Get("rear").Get(val);
         if (val < min) {
             min = val;
         }
         return min;
     }
-    static Tango::DevShort DBL2SHORT(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevShort DBL2SHORT(LiberaNodes &a_nodes) {
         istd_FTRC();
         double val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val;
     }
-    static Tango::DevLong CPU2LONG(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevLong CPU2LONG(LiberaNodes &a_nodes) {
         istd_FTRC();
         double user;
-        a_root.GetNode(mci::Tokenize(a_path + ".ID_4.value")).Get(user);
+        a_nodes.Get(".ID_4.value").Get(user);
         double kernel;
-        a_root.GetNode(mci::Tokenize(a_path + ".ID_5.value")).Get(kernel);
+        a_nodes.Get(".ID_5.value").Get(kernel);
         return user + kernel;
     }
-    static Tango::DevLong MEM2LONG(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevLong MEM2LONG(LiberaNodes &a_nodes) {
         istd_FTRC();
         double total;
-        a_root.GetNode(mci::Tokenize(a_path + ".ID_0.value")).Get(total);
+        a_nodes.Get(".ID_0.value").Get(total);
         double used;
-        a_root.GetNode(mci::Tokenize(a_path + ".ID_1.value")).Get(used);
+        a_nodes.Get(".ID_1.value").Get(used);
         return total - used;
     }
-    static Tango::DevLong SPEC2LONG(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevLong SPEC2LONG(LiberaNodes &a_nodes) {
         istd_FTRC();
         std::vector<uint32_t> val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val[0];
     }
-    static void LONG2SPEC(mci::Node &a_root, const std::string &a_path, const Tango::DevLong a_val) {
+    static void LONG2SPEC(LiberaNodes &a_nodes, const Tango::DevLong a_val) {
         istd_FTRC();
         //Get the Vector Values
         std::vector<uint32_t> val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        mci::Node node(a_nodes.Get());
+        node.Get(val);
         //Change only the First value
         val[0]=a_val;
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        node.Set(val);
     }
-    static Tango::DevShort USHORT2SHORT(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevShort USHORT2SHORT(LiberaNodes &a_nodes) {
         istd_FTRC();
         int64_t val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val < SHRT_MAX ? val : SHRT_MAX;
     }
-    static void SHORT2USHORT(mci::Node &a_root, const std::string &a_path, const Tango::DevShort a_val) {
+    static void SHORT2USHORT(LiberaNodes &a_nodes, const Tango::DevShort a_val) {
         istd_FTRC();
         int64_t val = a_val > 0 ? a_val : 0;
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        a_nodes.Get().Set(val);
     }
-    static Tango::DevLong ULONGLONG2LONG(mci::Node &a_root, const std::string &a_path) {
+    static Tango::DevLong ULONGLONG2LONG(LiberaNodes &a_nodes) {
         istd_FTRC();
         uint64_t val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val < UINT64_MAX  ? val : UINT64_MAX ;
     }
-    static void LONG2ULONGLONG(mci::Node &a_root, const std::string &a_path, const Tango::DevLong a_val) {
+    static void LONG2ULONGLONG(LiberaNodes &a_nodes, const Tango::DevLong a_val) {
         istd_FTRC();
         uint64_t val = a_val > 0 ? a_val : 0;
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        a_nodes.Get().Set(val);
     }
     //TODO Refactoring ASAP
-    static Tango::DevLong ULONG2LONGTHRSP(mci::Node &a_root, const std::string &a_path) { //, const Tango::DevLong min_val, const Tango::DevLong max_val) { //TODO Later make a template READER/WRITER Funct for different types
+    static Tango::DevLong ULONG2LONGTHRSP(LiberaNodes &a_nodes) { //, const Tango::DevLong min_val, const Tango::DevLong max_val) { //TODO Later make a template READER/WRITER Funct for different types
         istd_FTRC();
         uint32_t val;
 //        cout << "Less: " << min_val << ", Greater: " << max_val << endl;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         //std::string valid;
-        //if(a_root.GetNode(mci::Tokenize(a_path)).GetValidatorExpression(valid)) {
+        //if(a_nodes.Get().GetValidatorExpression(valid)) {
         //    cout << "Validator Expression: " << valid << endl;
         //}
         return val < (long)32768 ? val : (long)32768;
     }
 private:
     LiberaClient *m_client; // only needed when notification enabled
+    std::atomic<Subscription_e> m_subscription;
+protected:
+    LiberaLatency m_readLatency;  // registry read and conversion
+    LiberaLatency m_writeLatency; // conversion and registry write
 };
 
 #endif //LIBERA_ATTR_H
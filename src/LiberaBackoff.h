@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_BACKOFF_H
+#define LIBERA_BACKOFF_H
+
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+/*******************************************************************************
+ * Exponential backoff between retries. The delay doubles with each attempt
+ * up to the maximum, and a random part of up to half of it is taken off,
+ * so devices that lost connection together don't retry at the same time.
+ */
+class LiberaBackoff {
+public:
+    typedef std::chrono::milliseconds Duration;
+
+    LiberaBackoff(Duration a_min, Duration a_max, unsigned a_seed)
+      : m_min(a_min),
+        m_max(a_max),
+        m_attempts(0),
+        m_random(a_seed)
+    {
+    }
+
+    void SetLimits(Duration a_min, Duration a_max)
+    {
+        m_min = std::max(a_min, Duration(1));
+        m_max = std::max(a_max, m_min);
+    }
+
+    /**
+     * Delay before the next attempt.
+     */
+    Duration Next()
+    {
+        Duration delay(m_min);
+        for (unsigned i(0); i < m_attempts && delay < m_max; ++i) {
+            delay *= 2;
+        }
+        delay = std::min(delay, m_max);
+        ++m_attempts;
+        std::uniform_int_distribution<Duration::rep> jitter(0, delay.count() / 2);
+        return delay - Duration(jitter(m_random));
+    }
+
+    void Reset() { m_attempts = 0; }
+    unsigned GetAttempts() const { return m_attempts; }
+
+private:
+    Duration         m_min;
+    Duration         m_max;
+    unsigned         m_attempts; // failed attempts since last success
+    std::minstd_rand m_random;
+};
+
+#endif //LIBERA_BACKOFF_H
@@ -5,11 +5,16 @@
  * $Id: LiberaClient.cpp 18413 2013-01-09 11:53:17Z tomaz.beltram $
  */
 
+#include <sstream>
+#include <iomanip>
+#include <limits>
+
 #include <istd/trace.h>
 
 // MCI includes
 #include <mci/node.h>
 #include <mci/mci.h>
+#include <mci/notification_data.h>
 
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 #include <tango.h>
@@ -19,22 +24,39 @@
 
 #include "LiberaClient.h"
 
+const uint32_t LiberaClient::c_superviseMs;
+const size_t LiberaClient::c_supervisorThreads;
+
 /**
  * Constructor with member initializations.
  */
 LiberaClient::LiberaClient(Tango::DeviceImpl *a_deviceServer, std::string ip_address)
   : m_connected(false),
-    m_running(false),
+    m_running(true),
 	m_errorFlag(false),
-    m_thread(),
-    m_deviceServer(a_deviceServer)
+    m_phase(LiberaPollEngine::Instance().Register()),
+    m_eventWakeup(false),
+    m_deviceServer(a_deviceServer),
+    m_connectLimit(8),
+    m_reconnect(true),
+    m_supervised(false),
+    m_acquired(false),
+    m_generation(0),
+    m_backoff(LiberaBackoff::Duration(500), LiberaBackoff::Duration(30000),
+        static_cast<unsigned>(m_phase * 4294967295.0)),
+    m_supervisor(*this),
+    m_polls(0),
+    m_polledAttrs(0),
+    m_pollNs(0),
+    m_pollMaxNs(0),
+    m_pollLastNs(0),
+    m_slow(false),
+    m_events(false),
+    m_writeQueue([this](const std::string &a_error) {
+        SetError(a_error);
+    })
 {
     m_ip_address = "127.0.0.1";
-    m_thread = std::thread(std::ref(*this));
-    // safety check, wait that thread function has started
-    while (!m_running) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    };
     if (!ip_address.empty())
     {
       m_ip_address = ip_address;
@@ -42,18 +64,29 @@ LiberaClient::LiberaClient(Tango::DeviceImpl *a_deviceServer, std::string ip_add
 }
 
 /**
- * Wait for update thread to finish and delete destroy created objects.
+ * Wait for poll in progress to finish and delete destroy created objects.
+ * A failing poll schedules the supervisor and a reconnect schedules the
+ * poll, so the poll is cancelled again once the supervisor is gone.
  */
 LiberaClient::~LiberaClient()
 {
     istd_FTRC();
+    m_supervised = false;
     m_running = false;
-    if (m_thread.joinable()) {
-        m_thread.join();
+    LiberaPollEngine::Instance().Cancel(this);
+    GetSupervisorPool().Cancel(&m_supervisor, true);
+    LiberaPollEngine::Instance().Cancel(this);
+    Wake();
+    if (m_eventThread.joinable()) {
+        m_eventThread.join();
     }
+    Unsubscribe();
+    m_writeQueue.Stop(); // flush writes before attributes are destroyed
     m_signals.clear(); // destroy signal objects
     //m_attr_pm.clear(); // destroy platform attributes objects
     m_attr.clear(); // destroy atribute objects
+    std::lock_guard<std::mutex> l(m_connect_x);
+    Release();
 }
 
 /**
@@ -66,15 +99,40 @@ void LiberaClient::Notify(LiberaAttr *a_attr)
 }
 
 /**
- * Method for updating all attributes on the list. Its periodically called from
- * the update thread.
+ * Method for updating attributes whose poll class is due. Its periodically
+ * called from the polling engine, returns number of attributes read.
+ * Each class due at the start of the call is read at most once, classes
+ * that get due meanwhile are left for the next call.
+ * The due attributes are fetched concurrently on the fetch threads shared
+ * by all clients, each attribute is one job so the reads are spread evenly
+ * and the cycle time depends on the slowest read rather than their sum.
+ * The values are then stored and notified from this thread.
  */
-void LiberaClient::UpdateAttr()
+size_t LiberaClient::UpdateAttr()
 {
     istd_FTRC();
+    size_t count(0);
+    std::lock_guard<std::mutex> l(m_poll_x);
     try {
-        for (auto i = m_attr.begin(); i != m_attr.end(); ++i) {
-            (*i)->Read(m_root);
+        const LiberaPollScheduler::Clock::time_point now(LiberaPollScheduler::Clock::now());
+        const LiberaPollScheduler::AttrList *due;
+        while (m_running && (due = m_scheduler.Next(now))) {
+            m_due.clear();
+            for (auto i = due->begin(); i != due->end(); ++i) {
+                if ((*i)->GetSubscription() != LiberaAttr::eSubActive) {
+                    m_due.push_back(*i); // others updated on notification
+                }
+            }
+            count += m_due.size();
+            LiberaPollEngine::Instance().Fetch(m_due.size(), [this](size_t a_index) {
+                m_due[a_index]->Fetch();
+            });
+            for (auto i = m_due.begin(); i != m_due.end(); ++i) {
+                (*i)->Apply();
+                if (m_events && (*i)->GetSubscription() == LiberaAttr::eSubNone) {
+                    Subscribe(*i);
+                }
+            }
         }
         //for (auto i = m_attr_pm.begin(); i != m_attr_pm.end(); ++i) {
         //    (*i)->Read(m_platform);
@@ -86,30 +144,234 @@ void LiberaClient::UpdateAttr()
         istd_TRC(istd::eTrcLow, e.what());
         // let the server know it
         //m_deviceServer->set_lib_error(e.what());
-        m_errorFlag = true;
-        m_errorStatus = e.what();
+        SetError(e.what());
+        // values fetched before the failure are not applied later
+        for (auto i = m_due.begin(); i != m_due.end(); ++i) {
+            (*i)->Discard();
+        }
         m_connected = false;
+        if (m_supervised) {
+            GetSupervisorPool().Schedule(&m_supervisor, Clock::now());
+        }
+    }
+    // classes read for longer than their period are not due immediately
+    m_scheduler.Done(LiberaPollScheduler::Clock::now());
+    return count;
+}
+
+/**
+ * Report error of a poll or write thread to the server.
+ */
+void LiberaClient::SetError(const std::string &a_error)
+{
+    std::lock_guard<std::mutex> l(m_error_x);
+    m_errorStatus = a_error;
+    m_errorFlag = true;
+}
+
+/**
+ * Last reported error, safe to call while poll and write threads run.
+ */
+std::string LiberaClient::GetErrorStatus()
+{
+    std::lock_guard<std::mutex> l(m_error_x);
+    return m_errorStatus;
+}
+
+/**
+ * Wake up the notification thread to check for state change and poll
+ * without waiting for the next deadline.
+ */
+void LiberaClient::Wake()
+{
+    {
+        std::lock_guard<std::mutex> l(m_wake_x);
+        m_eventWakeup = true;
+        m_wake_cv.notify_all();
+    }
+    if (m_running && m_connected) {
+        LiberaPollEngine::Instance().Schedule(this, Clock::now());
     }
 }
+
 /**
- * Periodically read all attribute values.
+ * Wait until given time or until woken up. Each waiting thread has its own
+ * wakeup flag and returns immediately if it was woken up since last wait.
  */
-void LiberaClient::operator()()
+void LiberaClient::WaitUntil(LiberaPollScheduler::Clock::time_point a_deadline, bool &a_wakeup)
+{
+    std::unique_lock<std::mutex> l(m_wake_x);
+    while (!a_wakeup && m_running) {
+        if (a_deadline == LiberaPollScheduler::Clock::time_point::max()) {
+            // no deadline, wait_until would overflow converting the time
+            m_wake_cv.wait(l);
+        }
+        else if (m_wake_cv.wait_until(l, a_deadline) == std::cv_status::timeout) {
+            break;
+        }
+    }
+    a_wakeup = false;
+}
+
+/**
+ * One poll cycle run by the polling engine: read attribute values whose
+ * poll class is due and ask to be run again when the next class is due.
+ * Polling stops on disconnect and is resumed by Wake.
+ * A client whose cycle exceeds c_slowCycleMs, e.g. waiting for a device
+ * that times out, reserves an extra engine thread until a cycle is fast
+ * again, so the shared threads stay available to the other clients.
+ */
+bool LiberaClient::Run(Clock::time_point &a_next)
 {
     istd_FTRC();
-    // thread function has started
-    m_running = true;
-    while (m_running) {
-        if (m_connected) {
-            UpdateAttr();
-            std::this_thread::sleep_for(std::chrono::seconds(2));
+    if (!m_running || !m_connected) {
+        return false;
+    }
+    const Clock::time_point start(Clock::now());
+    const size_t count(UpdateAttr());
+    if (count > 0) {
+        const uint64_t ns(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start).count());
+        ++m_polls;
+        m_polledAttrs += count;
+        m_pollNs += ns;
+        m_pollLastNs = ns;
+        if (ns > m_pollMaxNs) {
+            m_pollMaxNs = ns; // written by one poll at a time
+        }
+    }
+    const bool slow(Clock::now() - start > std::chrono::milliseconds(c_slowCycleMs));
+    const bool polling(m_running && m_connected);
+    if (m_slow != (slow && polling)) {
+        m_slow = slow && polling;
+        LiberaPollEngine::Instance().Reserve(this, m_slow);
+    }
+    std::lock_guard<std::mutex> l(m_poll_x);
+    a_next = m_scheduler.GetDeadline();
+    return polling;
+}
+
+LiberaPollStats LiberaClient::GetPollStats() const
+{
+    LiberaPollStats stats;
+    stats.polls = m_polls;
+    stats.attrs = m_polledAttrs;
+    stats.totalNs = m_pollNs;
+    stats.maxNs = m_pollMaxNs;
+    stats.lastNs = m_pollLastNs;
+    return stats;
+}
+
+/**
+ * Register for change notification of the attribute node. The attribute is
+ * polled further if its node can not be registered.
+ */
+void LiberaClient::Subscribe(LiberaAttr *a_attr)
+{
+    istd_FTRC();
+    std::lock_guard<std::mutex> l(m_event_x);
+    if (!m_notifyClient) {
+        return;
+    }
+    a_attr->SetSubscription(LiberaAttr::eSubUnsupported);
+    try {
+        mci::Node node = a_attr->GetNotifyNode();
+        if (!node.IsValid()) {
+            return;
+        }
+        // several attributes may share the node, it is registered once
+        std::vector<LiberaAttr *> &attrs(m_subscribed[mci::ToString(node.GetRelPath())]);
+        if (!attrs.empty() || m_notifyClient->Register(node)) {
+            attrs.push_back(a_attr);
+            a_attr->SetSubscription(LiberaAttr::eSubActive);
         }
         else {
-            // wait for stop running
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            m_subscribed.erase(mci::ToString(node.GetRelPath()));
         }
     }
-    istd_TRC(istd::eTrcHigh, "Exit attribute update thread");
+    catch (istd::Exception e)
+    {
+        istd_TRC(istd::eTrcMed, "Exception thrown while registering notification!");
+        istd_TRC(istd::eTrcMed, e.what());
+    }
+}
+
+/**
+ * Drop notification client and return all attributes to polling.
+ */
+void LiberaClient::Unsubscribe()
+{
+    istd_FTRC();
+    std::lock_guard<std::mutex> pl(m_poll_x);
+    std::lock_guard<std::mutex> l(m_event_x);
+    m_notifyClient.reset();
+    m_subscribed.clear();
+    for (auto i = m_attr.begin(); i != m_attr.end(); ++i) {
+        (*i)->SetSubscription(LiberaAttr::eSubNone);
+    }
+}
+
+/**
+ * Wait for registry change notifications and update the attributes whose
+ * node has changed. Reading the value through the attribute reader keeps
+ * the unit conversion and notifier callbacks same as for polling.
+ */
+void LiberaClient::EventLoop()
+{
+    istd_FTRC();
+    while (m_running) {
+        std::shared_ptr<mci::NotificationClient> client;
+        {
+            std::lock_guard<std::mutex> l(m_event_x);
+            client = m_notifyClient;
+        }
+        if (!m_connected || !client) {
+            // wait for connect or stop running
+            WaitUntil(LiberaPollScheduler::Clock::time_point::max(), m_eventWakeup);
+            continue;
+        }
+        try {
+            mci::NotificationData data;
+            // timeout allows checking for stop running
+            if (!client->GetNotification(data, std::chrono::milliseconds(100))) {
+                continue;
+            }
+            std::vector<LiberaAttr *> attrs;
+            {
+                std::lock_guard<std::mutex> l(m_event_x);
+                auto i = m_subscribed.find(mci::ToString(data.GetNode().GetRelPath()));
+                if (i != m_subscribed.end()) {
+                    attrs = i->second;
+                }
+            }
+            if (!attrs.empty()) {
+                std::lock_guard<std::mutex> l(m_poll_x);
+                for (auto i = attrs.begin(); i != attrs.end(); ++i) {
+                    (*i)->Read();
+                }
+            }
+        }
+        catch (istd::Exception e)
+        {
+            istd_TRC(istd::eTrcLow, "Exception thrown while waiting for notification!");
+            istd_TRC(istd::eTrcLow, e.what());
+            // fall back to polling until next connect
+            Unsubscribe();
+        }
+    }
+    istd_TRC(istd::eTrcHigh, "Exit notification thread");
+}
+
+/**
+ * Enable or disable updating attributes on registry change notification
+ * instead of polling. Enabling takes effect on next Connect.
+ */
+void LiberaClient::EnableEvents(bool a_enable)
+{
+    m_events = a_enable;
+    if (!a_enable) {
+        Unsubscribe();
+    }
 }
 
 /**
@@ -118,9 +380,10 @@ void LiberaClient::operator()()
 bool LiberaClient::Execute(const std::string &a_path)
 {
     istd_FTRC();
+    LiberaLatency::Scope t(m_executeLatency);
     bool res = false;
     try {
-        res = m_root.GetNode(mci::Tokenize(a_path)).Execute();
+        res = GetRoot().GetNode(mci::Tokenize(a_path)).Execute();
     }
     catch (istd::Exception e)
     {
@@ -131,87 +394,440 @@ bool LiberaClient::Execute(const std::string &a_path)
 }
 
 /**
- * Recursively collect values for all sub-nodes.
+ * Visit a_node and its sub-nodes up to a_depth levels below it, depth first
+ * in registry order. Paths are built by appending node names to the parent
+ * path kept at the start of the path buffer. Values are passed as NULL for
+ * nodes without a readable value.
  */
-void LiberaClient::TreeWalk(
-    const mci::Node &a_node, Tango::DevVarStringArray *a_out)
+void LiberaClient::Walk(const mci::Node &a_node, size_t a_depth,
+    const std::function<void (const std::string &, const std::string *)> &a_visit)
 {
-    std::string s = mci::ToString(a_node.GetRelPath());
+    struct Item {
+        mci::Node node;
+        size_t    depth;
+        size_t    parentLen; // length of parent path in path buffer
+    };
+    std::vector<Item> stack;
+    std::string path(mci::ToString(a_node.GetRelPath()));
+    std::string value;
 
-    if (a_node.GetValueType() != mci::eNvUndefined && a_node.IsReadable()) {
-        s = s + "=" + a_node.ToString(0);
+    Item root = { a_node, 0, std::string::npos };
+    stack.push_back(root);
+    while (!stack.empty()) {
+        const Item item(stack.back());
+        stack.pop_back();
+        if (item.parentLen != std::string::npos) {
+            path.resize(item.parentLen);
+            if (!path.empty()) {
+                path += '.';
+            }
+            path += item.node.GetName();
+        }
+        if (item.node.GetValueType() != mci::eNvUndefined
+            && item.node.IsReadable()) {
+            value = item.node.ToString(0);
+            a_visit(path, &value);
+        }
+        else {
+            a_visit(path, NULL);
+        }
+        if (item.depth < a_depth) {
+            // pushed in reverse to keep the registry order
+            for (size_t i(item.node.GetNodeCount()); i > 0; --i) {
+                Item child = { item.node.GetNode(i - 1), item.depth + 1, path.size() };
+                stack.push_back(child);
+            }
+        }
     }
-    (*a_out)[a_out->length() - 1] = CORBA::string_dup(s.c_str());
+}
+
+namespace {
+    /**
+     * Output lines collected into one buffer, so the output sequence is
+     * sized once.
+     */
+    class Lines {
+    public:
+        void Add(const std::string &a_path, const std::string *a_value)
+        {
+            m_start.push_back(m_text.size());
+            m_text += a_path;
+            if (a_value) {
+                m_text += '=';
+                m_text += *a_value;
+            }
+            m_text += '\0';
+        }
+        void CopyTo(Tango::DevVarStringArray *a_out) const
+        {
+            a_out->length(m_start.size());
+            for (size_t i(0); i < m_start.size(); ++i) {
+                (*a_out)[i] = CORBA::string_dup(m_text.c_str() + m_start[i]);
+            }
+        }
+    private:
+        std::string         m_text;
+        std::vector<size_t> m_start;
+    };
 
-    for (size_t i(0); i < a_node.GetNodeCount(); ++i) {
-        a_out->length(a_out->length() + 1);
-        TreeWalk(a_node.GetNode(i), a_out);
+    /**
+     * 64 bit FNV-1a hash.
+     */
+    uint64_t Hash(const std::string &a_str)
+    {
+        uint64_t h(14695981039346656037ULL);
+        for (auto i = a_str.begin(); i != a_str.end(); ++i) {
+            h ^= static_cast<unsigned char>(*i);
+            h *= 1099511628211ULL;
+        }
+        return h;
     }
+
+    const uint64_t c_noValue = 0; // value hash of nodes without value
 }
 
 /**
- * Fill the output argument with value of the ireg node and its sub-nodes.
+ * Collect values for all sub-nodes.
  */
-bool LiberaClient::MagicCommand(
-    const std::string &a_path, Tango::DevVarStringArray *a_out)
+void LiberaClient::TreeWalk(const mci::Node &a_node,
+    Tango::DevVarStringArray *a_out, size_t a_depth, bool a_values)
 {
-    istd_FTRC();
-    bool res = false;
-    try {
-        if (a_path == "dump") {
-            TreeWalk(m_root, a_out);
+    Lines lines;
+    Walk(a_node, a_depth,
+        [&lines, a_values](const std::string &a_path, const std::string *a_value) {
+            if (a_value || !a_values) {
+                lines.Add(a_path, a_value);
+            }
+        });
+    lines.CopyTo(a_out);
+}
+
+/**
+ * Store hashes of all node paths and values of the registry under a_name.
+ */
+size_t LiberaClient::Snapshot(const std::string &a_name)
+{
+    std::shared_ptr<HashSnapshot> snap(new HashSnapshot);
+    Walk(GetRoot(), std::numeric_limits<size_t>::max(),
+        [&snap](const std::string &a_path, const std::string *a_value) {
+            (*snap)[Hash(a_path)] = a_value ? Hash(*a_value) : c_noValue;
+        });
+    const size_t size(snap->size());
+    HashSnapshotPtr prev(snap);
+    {
+        std::lock_guard<std::mutex> l(m_snapshot_x);
+        m_snapshots[a_name].swap(prev);
+    }
+    return size;
+}
+
+/**
+ * Fill the output argument with nodes whose value changed or that were
+ * added since snapshot a_name, followed by the number of removed nodes if
+ * any. Snapshot a_name is replaced with the current state if a_update is
+ * set, so repeated diffs return changes since the previous one. Without
+ * snapshot a_name the first one is taken and the diff is empty.
+ * Snapshots are immutable and shared, the lock is held only to take or
+ * replace the pointer, never while walking or comparing.
+ */
+void LiberaClient::Diff(const std::string &a_name, bool a_update,
+    Tango::DevVarStringArray *a_out)
+{
+    HashSnapshotPtr old;
+    {
+        std::lock_guard<std::mutex> l(m_snapshot_x);
+        auto i = m_snapshots.find(a_name);
+        if (i != m_snapshots.end()) {
+            old = i->second;
+        }
+    }
+    if (!old) {
+        Snapshot(a_name);
+        a_out->length(0);
+        return;
+    }
+    std::shared_ptr<HashSnapshot> snap;
+    if (a_update) {
+        snap.reset(new HashSnapshot);
+        snap->reserve(old->size());
+    }
+    Lines lines;
+    size_t found(0);
+    Walk(GetRoot(), std::numeric_limits<size_t>::max(),
+        [&](const std::string &a_path, const std::string *a_value) {
+            const uint64_t path(Hash(a_path));
+            const uint64_t value(a_value ? Hash(*a_value) : c_noValue);
+            auto i = old->find(path);
+            if (i != old->end()) {
+                ++found;
+            }
+            if (i == old->end() || i->second != value) {
+                lines.Add(a_path, a_value);
+            }
+            if (snap) {
+                (*snap)[path] = value;
+            }
+        });
+    if (found < old->size()) {
+        std::ostringstream s;
+        s << "removed=" << old->size() - found;
+        lines.Add(s.str(), NULL);
+    }
+    lines.CopyTo(a_out);
+    if (snap) {
+        HashSnapshotPtr prev(snap);
+        std::lock_guard<std::mutex> l(m_snapshot_x);
+        m_snapshots[a_name].swap(prev);
+    }
+}
+
+/**
+ * Fill the output argument with data on demand session counters of each
+ * signal, times are in microseconds.
+ */
+void LiberaClient::DodStats(Tango::DevVarStringArray *a_out)
+{
+    a_out->length(m_signals.size());
+    for (size_t i(0); i < m_signals.size(); ++i) {
+        const LiberaDodStats stats(m_signals[i]->GetDodStats());
+        std::ostringstream s;
+        s << m_signals[i]->GetPath()
+          << " opens=" << stats.opens
+          << " reuses=" << stats.reuses
+          << " open_us=" << (stats.opens ? stats.openNs / stats.opens / 1000 : 0)
+          << " saved_us=" << stats.SavedNs() / 1000;
+        (*a_out)[i] = CORBA::string_dup(s.str().c_str());
+    }
+}
+
+/**
+ * Fill the output argument with the poll cost of this device, times are in
+ * microseconds.
+ */
+void LiberaClient::PollStats(Tango::DevVarStringArray *a_out)
+{
+    const LiberaPollStats stats(GetPollStats());
+    std::ostringstream s;
+    s << "polls=" << stats.polls
+      << " attrs=" << stats.attrs
+      << " avg_us=" << (stats.polls ? stats.totalNs / stats.polls / 1000 : 0)
+      << " max_us=" << stats.maxNs / 1000
+      << " last_us=" << stats.lastNs / 1000
+      << " phase=" << m_phase
+      << " slow=" << (m_slow ? 1 : 0)
+      << " threads=" << LiberaPollEngine::Instance().GetThreads();
+    a_out->length(1);
+    (*a_out)[0] = CORBA::string_dup(s.str().c_str());
+}
+
+/**
+ * Fill the output argument with connection state of each signal.
+ */
+void LiberaClient::SignalStates(Tango::DevVarStringArray *a_out)
+{
+    a_out->length(m_signals.size());
+    for (size_t i(0); i < m_signals.size(); ++i) {
+        std::string s(m_signals[i]->GetPath());
+        if (m_signals[i]->IsConnected()) {
+            s += " connected";
         }
         else {
-            TreeWalk(m_root.GetNode(mci::Tokenize(std::string(a_path))), a_out);
+            s += " failed: " + m_signals[i]->GetError();
         }
+        (*a_out)[i] = CORBA::string_dup(s.c_str());
     }
-    catch (istd::Exception e)
-    {
-        istd_TRC(istd::eTrcLow, "Exception thrown on read node!");
-        istd_TRC(istd::eTrcLow, e.what());
-        a_out->length(1);
-        (*a_out)[0] = CORBA::string_dup(e.what());
+}
+
+/**
+ * Fill the output argument with the state of all shared connections of
+ * this process.
+ */
+void LiberaClient::ConnectionStates(Tango::DevVarStringArray *a_out)
+{
+    const std::vector<LiberaConnectionInfo> info(
+        LiberaConnections::Instance().GetInfo());
+    a_out->length(info.size());
+    for (size_t i(0); i < info.size(); ++i) {
+        std::ostringstream s;
+        s << info[i].address
+          << (info[i].type == mci::Root::Application ? " application" : " platform")
+          << " users=" << info[i].users
+          << " generation=" << info[i].generation
+          << (info[i].alive ? " alive" : " broken");
+        (*a_out)[i] = CORBA::string_dup(s.str().c_str());
     }
-    return res;
 }
 
 /**
- * Connection handling method.
+ * Collect latency summaries of all attributes, signals and commands that
+ * were recorded at least once. Attributes are named by their registry
+ * path with ":read" or ":write" appended, signals by their path with the
+ * acquisition step appended.
  */
-void LiberaClient::Connect(mci::Node &a_root, mci::Root a_type)
+void LiberaClient::GetLatency(
+    std::vector<std::pair<std::string, LiberaLatencySummary> > &a_out)
 {
-    // Destroy root node to force disconnect
-    if (a_root.IsValid()) {
-        try {
-            a_root.Destroy();
+    a_out.clear();
+    auto add = [&a_out](const std::string &a_name, const LiberaLatency &a_latency) {
+        const LiberaLatencySummary s(a_latency.GetSummary());
+        if (s.count > 0) {
+            a_out.push_back(std::make_pair(a_name, s));
         }
-        catch (istd::Exception e)
-        {
-            istd_TRC(istd::eTrcLow, "Exception thrown while destroying root node!");
-            istd_TRC(istd::eTrcLow, e.what());
+    };
+    add("execute", m_executeLatency);
+    add("magic", m_magicLatency);
+    for (auto i = m_attr.begin(); i != m_attr.end(); ++i) {
+        if (!(*i)->GetName().empty()) {
+            add((*i)->GetName() + ":read", (*i)->GetReadLatency());
+            add((*i)->GetName() + ":write", (*i)->GetWriteLatency());
         }
-        a_root = mci::Node();
     }
+    const char *steps[LiberaSignal::eLatencyCount] = { ":stream", ":dod", ":getdata" };
+    for (auto i = m_signals.begin(); i != m_signals.end(); ++i) {
+        for (size_t s(0); s < LiberaSignal::eLatencyCount; ++s) {
+            add((*i)->GetPath() + steps[s],
+                (*i)->GetLatency(static_cast<LiberaSignal::Latency_e>(s)));
+        }
+    }
+}
 
-    // disconnect if connected
-    try {
-        mci::Disconnect(m_ip_address.c_str(), a_type);
+void LiberaClient::ResetLatency()
+{
+    m_executeLatency.Reset();
+    m_magicLatency.Reset();
+    for (auto i = m_attr.begin(); i != m_attr.end(); ++i) {
+        (*i)->GetReadLatency().Reset();
+        (*i)->GetWriteLatency().Reset();
     }
-    catch (istd::Exception e)
-    {
-        istd_TRC(istd::eTrcLow, "Exception thrown while disconnecting root node!");
-        istd_TRC(istd::eTrcLow, e.what());
+    for (auto i = m_signals.begin(); i != m_signals.end(); ++i) {
+        for (size_t s(0); s < LiberaSignal::eLatencyCount; ++s) {
+            (*i)->GetLatency(static_cast<LiberaSignal::Latency_e>(s)).Reset();
+        }
     }
+}
 
-    // make new connection
+/**
+ * Fill the output argument with latency percentiles in microseconds.
+ */
+void LiberaClient::Latency(Tango::DevVarStringArray *a_out)
+{
+    std::vector<std::pair<std::string, LiberaLatencySummary> > latency;
+    GetLatency(latency);
+    a_out->length(latency.size());
+    for (size_t i(0); i < latency.size(); ++i) {
+        const LiberaLatencySummary &l(latency[i].second);
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(1) << latency[i].first
+          << " count=" << l.count
+          << " mean=" << l.meanNs / 1e3
+          << " p50=" << l.p50Ns / 1e3
+          << " p90=" << l.p90Ns / 1e3
+          << " p99=" << l.p99Ns / 1e3
+          << " p99.9=" << l.p999Ns / 1e3
+          << " max=" << l.maxNs / 1e3;
+        (*a_out)[i] = CORBA::string_dup(s.str().c_str());
+    }
+}
+
+/**
+ * Fill the output argument with value of the ireg node and its sub-nodes.
+ * The path, or "dump" for the whole registry, can be followed by options
+ * separated with spaces: "depth=N" limits the number of levels below the
+ * node and "values" lists only nodes with values.
+ * "snapshot [name]" stores hashes of the registry values, "diff [name]"
+ * lists only nodes changed since then, the first diff without a snapshot
+ * takes one and returns nothing. Diff without a name also advances the
+ * unnamed snapshot. "latency [on|off|reset]" switches recording of the
+ * latency histograms, which is off by default, and lists them.
+ */
+bool LiberaClient::MagicCommand(
+    const std::string &a_path, Tango::DevVarStringArray *a_out)
+{
+    istd_FTRC();
+    LiberaLatency::Scope t(m_magicLatency);
+    bool res = false;
     try {
-        a_root = mci::Connect(m_ip_address.c_str(), a_type);
+        std::istringstream args(a_path);
+        std::string path, opt;
+        args >> path;
+        if (path == "snapshot" || path == "diff") {
+            // unnamed diff compares with and replaces the unnamed snapshot
+            std::string name;
+            args >> name;
+            if (path == "diff") {
+                Diff(name, name.empty(), a_out);
+            }
+            else {
+                std::ostringstream s;
+                s << "nodes=" << Snapshot(name);
+                a_out->length(1);
+                (*a_out)[0] = CORBA::string_dup(s.str().c_str());
+            }
+            return res;
+        }
+        if (path == "latency") {
+            // "latency [on|off|reset]", recording is off by default
+            if (args >> opt) {
+                if (opt == "on" || opt == "off") {
+                    LiberaLatency::Enable(opt == "on");
+                }
+                else if (opt == "reset") {
+                    ResetLatency();
+                }
+                else {
+                    istd_EXCEPTION("Unknown option: " << opt);
+                }
+            }
+            Latency(a_out);
+            return res;
+        }
+        size_t depth(std::numeric_limits<size_t>::max());
+        bool values(false);
+        while (args >> opt) {
+            if (opt.compare(0, 6, "depth=") == 0) {
+                // digits only, stream extraction would accept "-1" and "3x"
+                const std::string digits(opt.substr(6));
+                std::istringstream val(digits);
+                if (digits.empty() ||
+                    digits.find_first_not_of("0123456789") != std::string::npos ||
+                    !(val >> depth)) {
+                    istd_EXCEPTION("Invalid depth: " << opt);
+                }
+            }
+            else if (opt == "values") {
+                values = true;
+            }
+            else {
+                istd_EXCEPTION("Unknown option: " << opt);
+            }
+        }
+        if (path == "dump") {
+            TreeWalk(GetRoot(), a_out, depth, values);
+        }
+        else if (path == "dodstats") {
+            DodStats(a_out);
+        }
+        else if (path == "pollstats") {
+            PollStats(a_out);
+        }
+        else if (path == "signals") {
+            SignalStates(a_out);
+        }
+        else if (path == "connections") {
+            ConnectionStates(a_out);
+        }
+        else {
+            TreeWalk(GetRoot().GetNode(mci::Tokenize(path)), a_out, depth, values);
+        }
     }
     catch (istd::Exception e)
     {
-        istd_TRC(istd::eTrcLow, "Exception thrown while connecting root node!");
+        istd_TRC(istd::eTrcLow, "Exception thrown on read node!");
         istd_TRC(istd::eTrcLow, e.what());
+        a_out->length(1);
+        (*a_out)[0] = CORBA::string_dup(e.what());
     }
+    return res;
 }
 
 /**
@@ -220,42 +836,45 @@ void LiberaClient::Connect(mci::Node &a_root, mci::Root a_type)
 bool LiberaClient::Connect(bool a_reuse_connection)
 {
     istd_FTRC();
-
-
-    bool reuseConnection(false);
-
-    if (a_reuse_connection) {
-        /* check if some other client has already opened connection to the instrument */
-        mci::Node n = mci::GetNode(m_ip_address.c_str(),  mci::Root::Application);
-        if (n.IsValid()) {
-            mci::ConnectionState state=mci::Ping(n);
-            if (state == mci::Connected) {
-                reuseConnection=true;
-                m_root = n;
-            }
-        }
+    std::lock_guard<std::mutex> l(m_connect_x);
+    // restore what fails to connect now in the background
+    m_supervised = m_reconnect.load();
+    m_backoff.Reset();
+    if (m_supervised) {
+        GetSupervisorPool().Schedule(&m_supervisor,
+            Clock::now() + std::chrono::milliseconds(c_superviseMs));
     }
 
     m_connected = false;
 
-    if (!reuseConnection) {
-        Connect(m_root, mci::Root::Application);
+    // The connection is shared with other clients of the instrument through
+    // the registry and renewed only if it is broken, so their sessions are
+    // kept. Without a_reuse_connection the connection is pinged now instead
+    // of relying on the last health check.
+    LiberaConnections &connections(LiberaConnections::Instance());
+    if (!m_acquired) {
+        SetRoot(connections.Acquire(m_ip_address, mci::Root::Application, m_generation));
+        m_acquired = true;
+    }
+    if (!connections.IsAlive(m_ip_address, mci::Root::Application,
+            m_generation, !a_reuse_connection)) {
+        SetRoot(connections.Renew(m_ip_address, mci::Root::Application, m_generation));
     }
     //Connect(m_platform, mci::Root::Platform);
 
     // update attributes for the first time
     //if (m_root.IsValid() && m_platform.IsValid()) {
     if (m_root.IsValid()) {
+        StartPolling();
         // set root node connection for signals
-        for (auto i = m_signals.begin(); i != m_signals.end(); ++i) {
-            if (!(*i)->Connect(m_root)) {
-            	m_connected = false;
-                istd_TRC(istd::eTrcLow, "Connection to signals failed.");
-                return false;
-            }
+        if (!ConnectSignals(false)) {
+            m_connected = false;
+            istd_TRC(istd::eTrcLow, "Connection to signals failed.");
+            return false;
         }
         // start attribute update loop
         m_connected = true;
+        Wake();
         istd_TRC(istd::eTrcLow, "Connection to application succeeded.");
     }
     else {
@@ -264,31 +883,219 @@ bool LiberaClient::Connect(bool a_reuse_connection)
     return m_connected;
 }
 
-void LiberaClient::Disconnect(mci::Node &a_root, mci::Root a_type)
+/**
+ * Rebuild node handle cache of all attributes and restart polling at the
+ * phase of this client.
+ */
+void LiberaClient::StartPolling()
 {
-    // destroy root node to force disconnect
-    try {
-        a_root.Destroy();
-    }
-    catch (istd::Exception e)
     {
-        istd_TRC(istd::eTrcLow, "Exception thrown while destroying root node!");
-        istd_TRC(istd::eTrcLow, e.what());
+        std::lock_guard<std::mutex> l(m_poll_x);
+        for (auto i = m_attr.begin(); i != m_attr.end(); ++i) {
+            (*i)->Resolve(m_root);
+        }
+        m_scheduler.Start(LiberaPollScheduler::Clock::now(), m_phase);
+    }
+    // notifications are registered again by the poll thread
+    Unsubscribe();
+    if (m_events) {
+        std::lock_guard<std::mutex> l(m_event_x);
+        m_notifyClient = std::make_shared<mci::NotificationClient>();
+        if (!m_eventThread.joinable()) {
+            m_eventThread = std::thread(&LiberaClient::EventLoop, this);
+        }
+    }
+}
+
+/**
+ * Enable or disable restoring lost connection in the background, with
+ * retry delays in milliseconds. Enabling takes effect on next Connect.
+ */
+void LiberaClient::SetReconnect(bool a_enable, uint32_t a_minDelay,
+    uint32_t a_maxDelay)
+{
+    m_reconnect = a_enable;
+    if (!a_enable) {
+        m_supervised = false;
+    }
+    std::lock_guard<std::mutex> l(m_connect_x);
+    m_backoff.SetLimits(LiberaBackoff::Duration(a_minDelay),
+        LiberaBackoff::Duration(a_maxDelay));
+}
+
+/**
+ * Pool running connection checks of all clients in the process, kept apart
+ * from the polling engine since reconnect attempts block on the network.
+ * It is created on first use and intentionally never destroyed, so it
+ * outlives static destruction of any client owner.
+ */
+LiberaWorkerPool &LiberaClient::GetSupervisorPool()
+{
+    static LiberaWorkerPool *pool = new LiberaWorkerPool(c_supervisorThreads);
+    return *pool;
+}
+
+/**
+ * Periodic connection check run by the supervisor pool. Lost connection is
+ * restored with exponential backoff between failed attempts. A client
+ * failing to reconnect reserves a thread of the pool until it succeeds, so
+ * unreachable devices don't delay the checks of the others.
+ */
+bool LiberaClient::Supervise(Clock::time_point &a_next)
+{
+    istd_FTRC();
+    if (!m_running || !m_supervised) {
+        GetSupervisorPool().Reserve(&m_supervisor, false);
+        return false;
+    }
+    std::unique_lock<std::mutex> l(m_connect_x, std::try_to_lock);
+    if (!l.owns_lock()) {
+        // connect in progress, check again later
+        a_next = Clock::now() + std::chrono::milliseconds(c_superviseMs);
+        return true;
+    }
+    if (!m_supervised) {
+        GetSupervisorPool().Reserve(&m_supervisor, false);
+        return false; // disconnected meanwhile
+    }
+    if (Restore()) {
+        if (m_backoff.GetAttempts() > 0) {
+            istd_TRC(istd::eTrcLow, "Connection restored: " << m_ip_address);
+        }
+        m_backoff.Reset();
+        a_next = Clock::now() + std::chrono::milliseconds(c_superviseMs);
+    }
+    else {
+        a_next = Clock::now() + m_backoff.Next();
+        istd_TRC(istd::eTrcLow, "Reconnect attempt " << m_backoff.GetAttempts()
+            << " failed: " << m_ip_address);
+    }
+    GetSupervisorPool().Reserve(&m_supervisor, m_backoff.GetAttempts() > 0);
+    return m_running;
+}
+
+/**
+ * Re-initialize only the lost parts of the connection. The root node is
+ * renewed only if the shared connection does not respond anymore or was
+ * already renewed by another client, in which case all signals are
+ * reconnected as well, otherwise only the failed signals are. Enabled
+ * signals resume acquisition once connected. Must be called with
+ * m_connect_x locked.
+ */
+bool LiberaClient::Restore()
+{
+    if (!m_acquired) {
+        return false;
     }
-    a_root = mci::Node();
+    LiberaConnections &connections(LiberaConnections::Instance());
+    // cached health check while polling works, fresh one after a failure
+    const bool alive(connections.IsAlive(m_ip_address,
+        mci::Root::Application, m_generation, !m_connected));
+    if (!alive) {
+        m_connected = false;
+        SetRoot(connections.Renew(m_ip_address, mci::Root::Application, m_generation));
+        if (!m_root.IsValid()) {
+            return false;
+        }
+    }
+    if (!m_connected) {
+        StartPolling();
+        m_connected = true;
+        Wake();
+    }
+    return ConnectSignals(alive);
+}
 
-    // disconnect if connected
-    mci::Disconnect(m_ip_address.c_str(), a_type);
+/**
+ * Set maximum number of signals connected at once.
+ */
+void LiberaClient::SetConnectConcurrency(size_t a_limit)
+{
+    m_connectLimit = std::max<size_t>(a_limit, 1);
+}
+
+/**
+ * Connect all signals, or only the disconnected ones, to the root node, up
+ * to m_connectLimit at once since each connect takes several round trips.
+ * All signals are tried, failures are reported per signal with the
+ * "signals" magic command.
+ */
+bool LiberaClient::ConnectSignals(bool a_failedOnly)
+{
+    istd_FTRC();
+    std::vector<LiberaSignal *> signals;
+    for (auto i = m_signals.begin(); i != m_signals.end(); ++i) {
+        if (!a_failedOnly || !(*i)->IsConnected()) {
+            signals.push_back(i->get());
+        }
+    }
+    if (signals.empty()) {
+        return true;
+    }
+    const size_t limit(std::min<size_t>(m_connectLimit, signals.size()));
+    LiberaForkJoin connect(limit > 1 ? limit - 1 : 0);
+    std::atomic<size_t> failed(0);
+    connect.Run(signals.size(), [this, &signals, &failed](size_t a_index) {
+        if (!signals[a_index]->Connect(m_root)) {
+            ++failed;
+        }
+    });
+    if (failed > 0) {
+        istd_TRC(istd::eTrcLow, "Signals not connected: " << failed
+            << " of " << signals.size());
+    }
+    return failed == 0;
+}
+
+/**
+ * Replace the root node, must be called with m_connect_x locked.
+ */
+void LiberaClient::SetRoot(const mci::Node &a_root)
+{
+    std::lock_guard<std::mutex> l(m_root_x);
+    m_root = a_root;
+}
+
+/**
+ * Copy of the root node for threads not holding m_connect_x, the node is
+ * replaced by the supervisor on reconnect.
+ */
+mci::Node LiberaClient::GetRoot()
+{
+    std::lock_guard<std::mutex> l(m_root_x);
+    return m_root;
+}
+
+/**
+ * Give the root node back to the registry, which closes the connection
+ * when no other client of the instrument uses it. Must be called with
+ * m_connect_x locked.
+ */
+void LiberaClient::Release()
+{
+    SetRoot(mci::Node());
+    if (m_acquired) {
+        LiberaConnections::Instance().Release(m_ip_address, mci::Root::Application);
+        m_acquired = false;
+    }
 }
 
 void LiberaClient::Disconnect()
 {
     istd_FTRC();
+    // explicit disconnect is not restored
+    m_supervised = false;
+    std::lock_guard<std::mutex> l(m_connect_x);
 
     // stop attribute update loop
     m_connected = false;
+    Unsubscribe();
 
-    Disconnect(m_root, mci::Root::Application);
+    // drop node handles of the old connection
+    for (auto i = m_attr.begin(); i != m_attr.end(); ++i) {
+        (*i)->Invalidate();
+    }
+    Release();
     //Disconnect(m_platform, mci::Root::Platform);
 }
 
@@ -8,16 +8,29 @@
 #ifndef LIBERA_CLIENT_H
 #define LIBERA_CLIENT_H
 
+#include <unordered_map>
+#include <type_traits>
+#include <mutex>
+#include <condition_variable>
+
 #include <mci/node.h>
+#include <mci/notification_client.h>
 
 #include "LiberaScalarAttr.h"
 #include "LiberaLogsAttr.h"
 #include "LiberaSignalAttr.h"
+#include "LiberaPollScheduler.h"
+#include "LiberaWriteQueue.h"
+#include "LiberaForkJoin.h"
+#include "LiberaPollEngine.h"
+#include "LiberaBackoff.h"
+#include "LiberaConnections.h"
 
 /*******************************************************************************
  * Class for handling connection to the Libera application.
+ * Attributes are polled by the process wide polling engine.
  */
-class LiberaClient {
+class LiberaClient : public LiberaTask {
 public:
     LiberaClient(Tango::DeviceImpl *a_deviceServer, std::string ip_address);
     ~LiberaClient();
@@ -25,8 +38,15 @@ public:
     bool Connect(bool a_reuse_connection = false);
     void Disconnect();
     bool IsConnected();
+    void EnableEvents(bool a_enable);
+    void SetConnectConcurrency(size_t a_limit);
+    void SetReconnect(bool a_enable, uint32_t a_minDelay = 500,
+        uint32_t a_maxDelay = 30000);
 
-    void operator ()();
+    virtual bool Run(Clock::time_point &a_next);
+    LiberaPollStats GetPollStats() const;
+    void GetLatency(std::vector<std::pair<std::string, LiberaLatencySummary> > &a_out);
+    void ResetLatency();
 
     /**
      *  Methods for adding different attribute types to the update list.
@@ -34,14 +54,57 @@ public:
      *  in this method call.
      *  Optional reader and writer function parameter is used for unit
      *  conversion and special node handling.
+     *  Node handles are resolved on Connect.
+     *  The attribute is polled with given period in milliseconds, see
+     *  LiberaPollPeriod_e for predefined classes. Periods shorter than
+     *  LiberaPollScheduler::c_minPeriod are raised to it.
      */
     template <typename TangoType>
     void AddScalar(const std::string &a_path, TangoType *&a_attr,
-        TangoType (*a_reader)(mci::Node &, const std::string &) = LiberaScalarAttr<TangoType>::DoRead,
-        void (*a_writer)(mci::Node &, const std::string &, const TangoType) = LiberaScalarAttr<TangoType>::DoWrite)
+        TangoType (*a_reader)(LiberaNodes &) = LiberaScalarAttr<TangoType>::DoRead,
+        void (*a_writer)(LiberaNodes &, const TangoType) = LiberaScalarAttr<TangoType>::DoWrite,
+        const uint32_t a_period = ePollNormal)
+    {
+        auto p = std::make_shared<LiberaScalarAttr<TangoType> >(a_path, a_attr, a_reader, a_writer);
+        std::lock_guard<std::mutex> l(m_poll_x);
+        m_attr.push_back(p);
+        // attribute memory is allocated by now and used as the index key
+        GetIndex(a_attr)[a_attr] = p.get();
+        m_scheduler.Add(p.get(), a_period);
+        Wake();
+    }
+
+    /**
+     * Add attribute with default reader and writer polled with given period.
+     * The period type is deduced, so a literal 0 selects this overload
+     * instead of converting to a null reader. Negative periods count as 0.
+     */
+    template <typename TangoType, typename Period>
+    typename std::enable_if<std::is_integral<Period>::value || std::is_enum<Period>::value>::type
+    AddScalar(const std::string &a_path, TangoType *&a_attr, const Period a_period)
     {
-        m_attr.push_back(
-            std::make_shared<LiberaScalarAttr<TangoType> >(a_path, a_attr, a_reader, a_writer));
+        AddScalar(a_path, a_attr, LiberaScalarAttr<TangoType>::DoRead,
+            LiberaScalarAttr<TangoType>::DoWrite,
+            a_period > 0 ? static_cast<uint32_t>(a_period) : 0);
+    }
+
+    /**
+     * Change poll period of already added attribute, periods shorter than
+     * LiberaPollScheduler::c_minPeriod are raised to it.
+     */
+    template <typename TangoType>
+    void SetPollPeriod(TangoType *&a_attr, const uint32_t a_period)
+    {
+        auto &index = GetIndex(a_attr);
+        auto i = index.find(a_attr);
+        if (i != index.end()) {
+            {
+                std::lock_guard<std::mutex> l(m_poll_x);
+                m_scheduler.Remove(i->second);
+                m_scheduler.Add(i->second, a_period);
+            }
+            Wake();
+        }
     }
 
     /**
@@ -50,8 +113,8 @@ public:
      */
 //    template <typename TangoType>
 //    void AddScalarPM(const std::string &a_path, TangoType *&a_attr,
-//        TangoType (*a_reader)(mci::Node &, const std::string &) = LiberaScalarAttr<TangoType>::DoRead,
-//        void (*a_writer)(mci::Node &, const std::string &, const TangoType) = LiberaScalarAttr<TangoType>::DoWrite)
+//        TangoType (*a_reader)(LiberaNodes &) = LiberaScalarAttr<TangoType>::DoRead,
+//        void (*a_writer)(LiberaNodes &, const TangoType) = LiberaScalarAttr<TangoType>::DoWrite)
 //    {
 //        m_attr_pm.push_back(
 //            std::make_shared<LiberaScalarAttr<TangoType> >(a_path, a_attr, a_reader, a_writer));
@@ -62,8 +125,10 @@ public:
      */
     void AddLogsRead(Tango::DevString *&a_attr, const size_t a_size)
     {
-        m_attr.push_back(
-            std::make_shared<LiberaLogsAttr>(a_attr, a_size));
+        auto p = std::make_shared<LiberaLogsAttr>(a_attr, a_size);
+        std::lock_guard<std::mutex> l(m_poll_x);
+        m_attr.push_back(p);
+        m_scheduler.Add(p.get(), ePollNormal);
     }
 
     /**
@@ -73,18 +138,19 @@ public:
     template<typename TangoDevice>
     void SetNotifier(Tango::DevBoolean *&a_attr, void (TangoDevice::*a_notifier)())
     {
-        for (auto i = m_attr.begin(); i != m_attr.end(); ++i) {
-            if ((*i)->IsEqual(a_attr)) {
-                m_notify[i->get()] = std::bind(a_notifier, m_deviceServer);
-                (*i)->EnableNotify(this);
-            }
+        auto i = m_index_bool.find(a_attr);
+        if (i != m_index_bool.end()) {
+            m_notify[i->second] = std::bind(a_notifier, m_deviceServer);
+            i->second->EnableNotify(this);
         }
     }
 
     void Notify(LiberaAttr *a_attr);
 
     /**
-     * Write the value to the attribute handling object.
+     * Write the value to the attribute handling object. An asynchronous
+     * write of the attribute not done yet is dropped, so it can not
+     * overwrite this value later.
      * Will disconnect in case of error.
      */
     template<typename TangoType>
@@ -92,12 +158,10 @@ public:
     {
         istd_FTRC();
         try {
-            // could be optimized using map<>::find() if needed
-            for (auto i = m_attr.begin(); i != m_attr.end(); ++i) {
-                if ((*i)->IsEqual(a_attr)) {
-                    auto p = std::dynamic_pointer_cast<LiberaScalarAttr<TangoType> >(*i);
-                    p->Write(m_root, a_val);
-                }
+            auto &index = GetIndex(a_attr);
+            auto i = index.find(a_attr);
+            if (i != index.end()) {
+                i->second->Write(a_val);
             }
         }
         catch (istd::Exception e)
@@ -106,9 +170,31 @@ public:
             istd_TRC(istd::eTrcLow, e.what());
             // let the server know it
             //m_deviceServer->set_lib_error(e.what());
-            m_errorFlag = true;
-            m_errorStatus = e.what();
+            SetError(e.what());
+        }
+    }
+
+    /**
+     * Queue the value to be written by the write queue thread and return
+     * without waiting. A newer value replaces one not written yet, its
+     * future completes when the newest value is written or fails.
+     */
+    template<typename TangoType>
+    std::shared_future<void> UpdateScalarAsync(TangoType *&a_attr, const TangoType a_val)
+    {
+        istd_FTRC();
+        std::shared_future<void> done;
+        auto &index = GetIndex(a_attr);
+        auto i = index.find(a_attr);
+        if (i == index.end()) {
+            std::promise<void> p;
+            p.set_value();
+            return p.get_future().share();
         }
+        if (i->second->WriteLater(a_val, done)) {
+            m_writeQueue.Push(i->second);
+        }
+        return done;
     }
 
     /**
@@ -125,33 +211,148 @@ public:
         return p.get(); // Return LiberaSignal<> object address as a handle.
     }
 
+    std::string GetErrorStatus();
+
     bool Execute(const std::string &a_path);
     bool MagicCommand(const std::string &a_path, Tango::DevVarStringArray *a_out);
 private:
 
-    void UpdateAttr();
-    void Connect(mci::Node &a_root, mci::Root a_type);
-    void Disconnect(mci::Node &a_root, mci::Root a_type);
-    void TreeWalk(const mci::Node &a_node, Tango::DevVarStringArray *a_out);
+    size_t UpdateAttr();
+    void SetError(const std::string &a_error);
+    void Wake();
+    void WaitUntil(LiberaPollScheduler::Clock::time_point a_deadline, bool &a_wakeup);
+    void Subscribe(LiberaAttr *a_attr);
+    void Unsubscribe();
+    void EventLoop();
+    void Walk(const mci::Node &a_node, size_t a_depth,
+        const std::function<void (const std::string &, const std::string *)> &a_visit);
+    void TreeWalk(const mci::Node &a_node, Tango::DevVarStringArray *a_out,
+        size_t a_depth, bool a_values);
+    size_t Snapshot(const std::string &a_name);
+    void Diff(const std::string &a_name, bool a_update,
+        Tango::DevVarStringArray *a_out);
+    void DodStats(Tango::DevVarStringArray *a_out);
+    void PollStats(Tango::DevVarStringArray *a_out);
+    void SignalStates(Tango::DevVarStringArray *a_out);
+    void ConnectionStates(Tango::DevVarStringArray *a_out);
+    void Latency(Tango::DevVarStringArray *a_out);
+    void Release();
+    void SetRoot(const mci::Node &a_root);
+    mci::Node GetRoot();
+    bool ConnectSignals(bool a_failedOnly);
+    void StartPolling();
+    static LiberaWorkerPool &GetSupervisorPool();
+    bool Supervise(Clock::time_point &a_next);
+    bool Restore();
+
+    /**
+     * Reconnect task of the client, run by the supervisor pool.
+     */
+    class Supervisor : public LiberaTask {
+    public:
+        explicit Supervisor(LiberaClient &a_client) : m_client(a_client) {}
+        virtual bool Run(Clock::time_point &a_next)
+        {
+            return m_client.Supervise(a_next);
+        }
+    private:
+        LiberaClient &m_client;
+    };
+
+    /**
+     * Scalar attribute lookup by attribute memory address, one map for each
+     * supported type. The overload is selected by the attribute pointer type.
+     */
+    template <typename TangoType>
+    struct Index {
+        typedef std::unordered_map<const TangoType *, LiberaScalarAttr<TangoType> *> Type;
+    };
+    Index<Tango::DevDouble>::Type  &GetIndex(Tango::DevDouble *)  { return m_index_double; }
+    Index<Tango::DevLong>::Type    &GetIndex(Tango::DevLong *)    { return m_index_long; }
+    Index<Tango::DevULong>::Type   &GetIndex(Tango::DevULong *)   { return m_index_ulong; }
+    Index<Tango::DevShort>::Type   &GetIndex(Tango::DevShort *)   { return m_index_short; }
+    Index<Tango::DevUShort>::Type  &GetIndex(Tango::DevUShort *)  { return m_index_ushort; }
+    Index<Tango::DevBoolean>::Type &GetIndex(Tango::DevBoolean *) { return m_index_bool; }
 
     std::atomic<bool>   m_connected;
     std::atomic<bool>   m_running;
-    std::thread         m_thread;
+    const double        m_phase; // poll phase within the period
+
+    // wakes up threads waiting for deadline on state change
+    std::mutex              m_wake_x;
+    std::condition_variable m_wake_cv;
+    bool                    m_eventWakeup; // notification thread
 
     Tango::DeviceImpl *m_deviceServer; // used for changing device state
 
     std::string m_ip_address;
 
-    mci::Node            m_root;
+    std::mutex           m_root_x; // written with m_connect_x locked as well
+    mci::Node            m_root;   // read under either lock, see GetRoot
     //mci::Node            m_platform;
 
     std::vector<std::shared_ptr<LiberaAttr> >   m_attr;    // list of attributes to be updated
     //std::vector<std::shared_ptr<LiberaAttr> >   m_attr_pm; // platform list of attributes
     std::vector<std::shared_ptr<LiberaSignal> > m_signals; // list of managed signals
     std::map<LiberaAttr *, std::function<void ()> > m_notify; // map of notification callbacks
+
+    std::mutex          m_poll_x; // protects attribute list and scheduler
+    LiberaPollScheduler m_scheduler;
+
+    LiberaPollScheduler::AttrList m_due; // attributes being polled
+
+    std::atomic<size_t> m_connectLimit; // signals connected at once
+
+    // connection supervision, restores lost connection in the background
+    static const uint32_t c_superviseMs = 1000; // check period when connected
+    static const size_t c_supervisorThreads = 2;
+    std::mutex          m_connect_x;  // serializes connect and restore
+    std::atomic<bool>   m_reconnect;  // supervision enabled
+    std::atomic<bool>   m_supervised; // connected once and not disconnected
+    bool                m_acquired;   // root node taken from the registry
+    uint64_t            m_generation; // registry connection generation of m_root
+    LiberaBackoff       m_backoff;
+    Supervisor          m_supervisor;
+
+    // poll cost
+    std::atomic<uint64_t> m_polls;
+    std::atomic<uint64_t> m_polledAttrs;
+    std::atomic<uint64_t> m_pollNs;
+    std::atomic<uint64_t> m_pollMaxNs;
+    std::atomic<uint64_t> m_pollLastNs;
+
+    // cycles longer than this get the client an engine thread of its own
+    static const uint32_t c_slowCycleMs = 100;
+    bool                  m_slow; // written by one poll at a time
+
+    // registry change notifications, polling is used as fallback
+    std::atomic<bool>   m_events;
+    std::thread         m_eventThread;
+    std::mutex          m_event_x; // protects notification client and map
+    std::shared_ptr<mci::NotificationClient>     m_notifyClient;
+    std::unordered_map<std::string, std::vector<LiberaAttr *> > m_subscribed; // by node path
+
+    Index<Tango::DevDouble>::Type  m_index_double;
+    Index<Tango::DevLong>::Type    m_index_long;
+    Index<Tango::DevULong>::Type   m_index_ulong;
+    Index<Tango::DevShort>::Type   m_index_short;
+    Index<Tango::DevUShort>::Type  m_index_ushort;
+    Index<Tango::DevBoolean>::Type m_index_bool;
+
+    LiberaWriteQueue m_writeQueue; // asynchronous scalar writes
+
+    LiberaLatency m_executeLatency;
+    LiberaLatency m_magicLatency;
+
+    // registry snapshots by name, node path hash to value hash
+    typedef std::unordered_map<uint64_t, uint64_t> HashSnapshot;
+    typedef std::shared_ptr<const HashSnapshot> HashSnapshotPtr;
+    std::mutex                             m_snapshot_x; // guards the map only
+    std::map<std::string, HashSnapshotPtr> m_snapshots;
+    std::mutex m_error_x; // protects m_errorStatus
 public:
-    std::string m_errorStatus;
-    bool m_errorFlag;
+    std::string m_errorStatus; // use GetErrorStatus while connected
+    std::atomic<bool> m_errorFlag;
 };
 
 #endif //LIBERA_CLIENT_H
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include <istd/trace.h>
+#include <mci/mci.h>
+
+#include "LiberaConnections.h"
+
+const uint32_t LiberaConnections::c_checkMs;
+
+LiberaConnections::LiberaConnections()
+{
+    istd_FTRC();
+}
+
+/**
+ * Registry is created on first use and intentionally never destroyed, so
+ * it outlives static destruction of any client owner.
+ */
+LiberaConnections &LiberaConnections::Instance()
+{
+    static LiberaConnections *connections = new LiberaConnections();
+    return *connections;
+}
+
+LiberaConnections::EntryPtr LiberaConnections::Find(const std::string &a_address,
+    mci::Root a_type)
+{
+    std::lock_guard<std::mutex> l(m_x);
+    auto i = m_entries.find(Key(a_address, a_type));
+    return i != m_entries.end() ? i->second : EntryPtr();
+}
+
+/**
+ * Connect the entry, adopting a connection that was already opened in this
+ * process and still responds. Must be called with the entry locked.
+ */
+void LiberaConnections::Open(const std::string &a_address, mci::Root a_type,
+    Entry &a_entry)
+{
+    try {
+        mci::Node n = mci::GetNode(a_address.c_str(), a_type);
+        if (n.IsValid() && mci::Ping(n) == mci::Connected) {
+            a_entry.root = n;
+        }
+    }
+    catch (istd::Exception e)
+    {
+        istd_TRC(istd::eTrcLow, "Exception thrown while checking existing root node!");
+        istd_TRC(istd::eTrcLow, e.what());
+    }
+
+    if (!a_entry.root.IsValid()) {
+        // disconnect if connected
+        try {
+            mci::Disconnect(a_address.c_str(), a_type);
+        }
+        catch (istd::Exception e)
+        {
+            istd_TRC(istd::eTrcLow, "Exception thrown while disconnecting root node!");
+            istd_TRC(istd::eTrcLow, e.what());
+        }
+
+        // make new connection
+        try {
+            a_entry.root = mci::Connect(a_address.c_str(), a_type);
+        }
+        catch (istd::Exception e)
+        {
+            istd_TRC(istd::eTrcLow, "Exception thrown while connecting root node!");
+            istd_TRC(istd::eTrcLow, e.what());
+        }
+    }
+
+    if (a_entry.root.IsValid()) {
+        ++a_entry.generation;
+        a_entry.alive = true;
+        a_entry.checked = Clock::now();
+    }
+}
+
+/**
+ * Destroy the root node and disconnect. Must be called with the entry
+ * locked.
+ */
+void LiberaConnections::Close(const std::string &a_address, mci::Root a_type,
+    Entry &a_entry)
+{
+    if (a_entry.root.IsValid()) {
+        try {
+            a_entry.root.Destroy();
+        }
+        catch (istd::Exception e)
+        {
+            istd_TRC(istd::eTrcLow, "Exception thrown while destroying root node!");
+            istd_TRC(istd::eTrcLow, e.what());
+        }
+    }
+    a_entry.root = mci::Node();
+    a_entry.alive = false;
+
+    try {
+        mci::Disconnect(a_address.c_str(), a_type);
+    }
+    catch (istd::Exception e)
+    {
+        istd_TRC(istd::eTrcLow, "Exception thrown while disconnecting root node!");
+        istd_TRC(istd::eTrcLow, e.what());
+    }
+}
+
+/**
+ * Register a user of the connection and return its root node, connecting
+ * if this is the first user. The returned node is not valid if the
+ * connection failed, the user must release it in any case. A connection
+ * to the same instrument that is still being closed is waited for.
+ */
+mci::Node LiberaConnections::Acquire(const std::string &a_address,
+    mci::Root a_type, uint64_t &a_generation)
+{
+    istd_FTRC();
+    EntryPtr e;
+    EntryPtr closing;
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        const Key key(a_address, a_type);
+        EntryPtr &entry(m_entries[key]);
+        if (!entry) {
+            entry = std::make_shared<Entry>();
+            auto i = m_closing.find(key);
+            if (i != m_closing.end()) {
+                closing = i->second;
+            }
+        }
+        e = entry;
+        ++e->users;
+    }
+    std::lock_guard<std::mutex> l(e->x);
+    if (closing) {
+        std::unique_lock<std::mutex> cl(closing->x);
+        while (!closing->closed) {
+            closing->cv.wait(cl);
+        }
+    }
+    if (!e->root.IsValid()) {
+        Open(a_address, a_type, *e);
+    }
+    a_generation = e->generation;
+    return e->root;
+}
+
+/**
+ * Unregister a user, the connection is closed when the last user is gone.
+ * The entry is removed under the registry lock but closed holding only its
+ * own lock, so other instruments are not blocked meanwhile. A new user of
+ * the same instrument waits in Acquire until the close is done.
+ */
+void LiberaConnections::Release(const std::string &a_address, mci::Root a_type)
+{
+    istd_FTRC();
+    const Key key(a_address, a_type);
+    EntryPtr e;
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        auto i = m_entries.find(key);
+        if (i == m_entries.end()) {
+            return;
+        }
+        if (--i->second->users > 0) {
+            return;
+        }
+        e = i->second;
+        m_entries.erase(i);
+        m_closing[key] = e;
+    }
+    {
+        std::lock_guard<std::mutex> el(e->x);
+        Close(a_address, a_type, *e);
+        e->closed = true;
+    }
+    e->cv.notify_all();
+    std::lock_guard<std::mutex> l(m_x);
+    auto i = m_closing.find(key);
+    if (i != m_closing.end() && i->second == e) {
+        m_closing.erase(i);
+    }
+}
+
+/**
+ * Check if the connection of given generation still responds. The result
+ * of the last ping is reused within the check period unless a_force is set.
+ */
+bool LiberaConnections::IsAlive(const std::string &a_address, mci::Root a_type,
+    uint64_t a_generation, bool a_force)
+{
+    EntryPtr entry(Find(a_address, a_type));
+    if (!entry) {
+        return false;
+    }
+    std::lock_guard<std::mutex> l(entry->x);
+    if (a_generation != entry->generation || !entry->root.IsValid()) {
+        return false;
+    }
+    const Clock::time_point now(Clock::now());
+    if (a_force || now - entry->checked >= std::chrono::milliseconds(c_checkMs)) {
+        try {
+            entry->alive = mci::Ping(entry->root) == mci::Connected;
+        }
+        catch (istd::Exception e)
+        {
+            istd_TRC(istd::eTrcMed, "Exception thrown while checking root node!");
+            istd_TRC(istd::eTrcMed, e.what());
+            entry->alive = false;
+        }
+        entry->checked = now;
+    }
+    return entry->alive;
+}
+
+/**
+ * Reconnect a broken connection of given generation. If another user has
+ * already reconnected it, the current root node is returned instead of
+ * reconnecting again.
+ */
+mci::Node LiberaConnections::Renew(const std::string &a_address,
+    mci::Root a_type, uint64_t &a_generation)
+{
+    istd_FTRC();
+    EntryPtr e(Find(a_address, a_type));
+    if (!e) {
+        return mci::Node();
+    }
+    std::lock_guard<std::mutex> l(e->x);
+    if (a_generation == e->generation || !e->root.IsValid()) {
+        Close(a_address, a_type, *e);
+        Open(a_address, a_type, *e);
+    }
+    a_generation = e->generation;
+    return e->root;
+}
+
+std::vector<LiberaConnectionInfo> LiberaConnections::GetInfo()
+{
+    std::vector<EntryPtr> entries;
+    std::vector<LiberaConnectionInfo> info;
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        for (auto i = m_entries.begin(); i != m_entries.end(); ++i) {
+            LiberaConnectionInfo c;
+            c.address = i->first.first;
+            c.type = i->first.second;
+            c.users = i->second->users;
+            info.push_back(c);
+            entries.push_back(i->second);
+        }
+    }
+    for (size_t i(0); i < entries.size(); ++i) {
+        std::lock_guard<std::mutex> l(entries[i]->x);
+        info[i].generation = entries[i]->generation;
+        info[i].alive = entries[i]->alive;
+    }
+    return info;
+}
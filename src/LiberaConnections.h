@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_CONNECTIONS_H
+#define LIBERA_CONNECTIONS_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <mci/node.h>
+
+/**
+ * State of one shared connection, as reported by the registry.
+ */
+struct LiberaConnectionInfo {
+    std::string address;
+    mci::Root   type;
+    size_t      users;
+    uint64_t    generation; // incremented on each reconnect
+    bool        alive;      // result of the last health check
+};
+
+/*******************************************************************************
+ * Process wide registry of instrument connections shared by all clients.
+ * Root nodes are handed out per instrument address and root type and the
+ * connection is closed only when its last user releases it. A connection is
+ * health checked at most once per check period, no matter how many clients
+ * use it. Each reconnect starts a new generation, so a client holding the
+ * root node of an older generation knows its node handles are stale.
+ */
+class LiberaConnections {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static LiberaConnections &Instance();
+
+    mci::Node Acquire(const std::string &a_address, mci::Root a_type,
+        uint64_t &a_generation);
+    void Release(const std::string &a_address, mci::Root a_type);
+    bool IsAlive(const std::string &a_address, mci::Root a_type,
+        uint64_t a_generation, bool a_force = false);
+    mci::Node Renew(const std::string &a_address, mci::Root a_type,
+        uint64_t &a_generation);
+    std::vector<LiberaConnectionInfo> GetInfo();
+
+private:
+    LiberaConnections();
+
+    struct Entry {
+        Entry() : users(0), generation(0), alive(false), closed(false) {}
+        std::mutex              x; // serializes connect and health check
+        std::condition_variable cv; // signals closed
+        mci::Node               root;
+        size_t                  users;
+        uint64_t                generation;
+        bool                    alive;
+        bool                    closed; // released and disconnected
+        Clock::time_point       checked;
+    };
+    typedef std::pair<std::string, mci::Root> Key;
+    typedef std::shared_ptr<Entry> EntryPtr;
+
+    EntryPtr Find(const std::string &a_address, mci::Root a_type);
+    static void Open(const std::string &a_address, mci::Root a_type, Entry &a_entry);
+    static void Close(const std::string &a_address, mci::Root a_type, Entry &a_entry);
+
+    static const uint32_t c_checkMs = 1000; // health check period
+
+    std::mutex                 m_x; // protects the maps
+    std::map<Key, EntryPtr>    m_entries;
+    std::map<Key, EntryPtr>    m_closing; // released, being disconnected
+};
+
+#endif //LIBERA_CONNECTIONS_H
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_DECIMATE_H
+#define LIBERA_DECIMATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+/**
+ * Signal decimation methods.
+ */
+enum LiberaDecimation_e {
+    eDecimationNone,
+    eDecimationBoxcar,  // average of each a_factor atoms
+    eDecimationCic,     // third order CIC filter, decimated by a_factor
+    eDecimationEnvelope // min and max of each a_factor atoms, interleaved
+};
+
+/**
+ * Largest CIC decimation factor, the filter gain of factor^3 applied to a
+ * 32 bit signal must fit into 64 bits.
+ */
+const size_t c_cicMaxFactor = 1024;
+
+/**
+ * CIC filter order. The first c_cicOrder - 1 outputs of a buffer depend on
+ * samples before its start and are dropped, the filter state is not kept
+ * between buffers.
+ */
+const size_t c_cicOrder = 3;
+
+inline bool LiberaIsDecimated(LiberaDecimation_e a_type, size_t a_factor)
+{
+    return a_type != eDecimationNone && a_factor > 1;
+}
+
+/**
+ * Number of samples per column after decimation. Incomplete trailing blocks
+ * and CIC start-up outputs are dropped.
+ */
+inline size_t LiberaDecimatedLength(LiberaDecimation_e a_type,
+    size_t a_factor, size_t a_length)
+{
+    if (!LiberaIsDecimated(a_type, a_factor)) {
+        return a_length;
+    }
+    const size_t blocks(a_length / a_factor);
+    if (a_type == eDecimationCic) {
+        return blocks >= c_cicOrder ? blocks - (c_cicOrder - 1) : 0;
+    }
+    return a_type == eDecimationEnvelope ? 2 * blocks : blocks;
+}
+
+inline void LiberaDecimateStore(double &a_dst, double a_val)
+{
+    a_dst = a_val;
+}
+
+inline void LiberaDecimateStore(int16_t &a_dst, double a_val)
+{
+    a_dst = static_cast<int16_t>(std::lround(a_val));
+}
+
+/**
+ * Decimate a_cols columns of a_rows atoms, stored one after another
+ * a_stride components apart, into column arrays of LiberaDecimatedLength.
+ */
+template <typename S, typename D>
+void LiberaDecimate(LiberaDecimation_e a_type, size_t a_factor,
+    const S *a_src, size_t a_stride, size_t a_rows,
+    D *const *a_dst, size_t a_cols)
+{
+    const size_t f(std::max<size_t>(a_factor, 1));
+    const size_t blocks(a_rows / f);
+
+    if (a_type == eDecimationCic) {
+        // Integrators run at full rate, combs at decimated rate. Unsigned
+        // arithmetic wraps around, which the comb stages cancel out. The
+        // first blocks only fill the comb delays.
+        const double gain(double(f) * f * f);
+        for (size_t c(0); c < a_cols; ++c) {
+            uint64_t i1(0), i2(0), i3(0), c1(0), c2(0), c3(0);
+            const S *s(a_src + c);
+            D *d(a_dst[c]);
+            for (size_t k(0); k < blocks; ++k) {
+                for (size_t r(0); r < f; ++r, s += a_stride) {
+                    i1 += static_cast<uint64_t>(static_cast<int64_t>(*s));
+                    i2 += i1;
+                    i3 += i2;
+                }
+                const uint64_t y1(i3 - c1);
+                c1 = i3;
+                const uint64_t y2(y1 - c2);
+                c2 = y1;
+                const uint64_t y3(y2 - c3);
+                c3 = y2;
+                if (k >= c_cicOrder - 1) {
+                    LiberaDecimateStore(d[k - (c_cicOrder - 1)],
+                        static_cast<int64_t>(y3) / gain);
+                }
+            }
+        }
+        return;
+    }
+
+    // Boxcar and envelope are accumulated row by row for a chunk of columns,
+    // reading the atoms sequentially.
+    const size_t chunk(16);
+    for (size_t c0(0); c0 < a_cols; c0 += chunk) {
+        const size_t n(std::min(chunk, a_cols - c0));
+        const S *row(a_src + c0);
+        for (size_t k(0); k < blocks; ++k) {
+            double sum[chunk];
+            S lo[chunk], hi[chunk];
+            for (size_t c(0); c < n; ++c) {
+                sum[c] = 0;
+                lo[c] = row[c];
+                hi[c] = row[c];
+            }
+            for (size_t r(0); r < f; ++r, row += a_stride) {
+                for (size_t c(0); c < n; ++c) {
+                    sum[c] += row[c];
+                    lo[c] = std::min(lo[c], row[c]);
+                    hi[c] = std::max(hi[c], row[c]);
+                }
+            }
+            for (size_t c(0); c < n; ++c) {
+                D *d(a_dst[c0 + c]);
+                if (a_type == eDecimationEnvelope) {
+                    LiberaDecimateStore(d[2 * k], lo[c]);
+                    LiberaDecimateStore(d[2 * k + 1], hi[c]);
+                }
+                else {
+                    LiberaDecimateStore(d[k], sum[c] / f);
+                }
+            }
+        }
+    }
+}
+
+#endif //LIBERA_DECIMATE_H
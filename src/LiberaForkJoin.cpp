@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include <istd/trace.h>
+
+#include "LiberaForkJoin.h"
+
+LiberaForkJoin::LiberaForkJoin(size_t a_threads)
+  : m_running(true)
+{
+    istd_FTRC();
+    for (size_t i(0); i < a_threads; ++i) {
+        m_threads.push_back(std::thread(&LiberaForkJoin::Worker, this));
+    }
+}
+
+LiberaForkJoin::~LiberaForkJoin()
+{
+    istd_FTRC();
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        m_running = false;
+    }
+    m_cv.notify_all();
+    for (auto i = m_threads.begin(); i != m_threads.end(); ++i) {
+        if (i->joinable()) {
+            i->join();
+        }
+    }
+}
+
+/**
+ * Call a_job for indexes 0 to a_count - 1 and wait for all calls to finish.
+ * At most a_limit jobs are run at once, zero means one per thread. The
+ * first exception thrown by a job is rethrown after the batch completes,
+ * remaining jobs are still run.
+ */
+void LiberaForkJoin::Run(size_t a_count, const Job &a_job, size_t a_limit)
+{
+    if (a_count == 0) {
+        return;
+    }
+    Batch b = { &a_job, a_count, 0, 0,
+        a_limit ? a_limit : m_threads.size() + 1, std::exception_ptr() };
+    std::unique_lock<std::mutex> l(m_x);
+    m_batches.push_back(&b);
+    m_cv.notify_all();
+
+    while (b.next < b.count || b.active > 0) {
+        if (b.next < b.count && b.active < b.limit) {
+            Work(b, l);
+        }
+        else {
+            m_done_cv.wait(l);
+        }
+    }
+    l.unlock();
+    if (b.error) {
+        std::rethrow_exception(b.error);
+    }
+}
+
+/**
+ * Take and run the next job of the batch. The batch is dropped from the
+ * list when its last job is taken. Called with the lock held.
+ */
+void LiberaForkJoin::Work(Batch &a_batch, std::unique_lock<std::mutex> &a_lock)
+{
+    const size_t index(a_batch.next++);
+    if (a_batch.next == a_batch.count) {
+        m_batches.remove(&a_batch);
+    }
+    const Job &job(*a_batch.job);
+    ++a_batch.active;
+    a_lock.unlock();
+    std::exception_ptr error;
+    try {
+        job(index);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    a_lock.lock();
+    if (error && !a_batch.error) {
+        a_batch.error = error;
+    }
+    --a_batch.active;
+    if (a_batch.next < a_batch.count) {
+        // a job may have been held back by the limit
+        m_cv.notify_all();
+    }
+    m_done_cv.notify_all();
+}
+
+/**
+ * Worker thread, runs jobs of the oldest batch with jobs left.
+ */
+void LiberaForkJoin::Worker()
+{
+    std::unique_lock<std::mutex> l(m_x);
+    while (m_running) {
+        Batch *batch(NULL);
+        for (auto i = m_batches.begin(); i != m_batches.end(); ++i) {
+            if ((*i)->active < (*i)->limit) {
+                batch = *i;
+                break;
+            }
+        }
+        if (batch) {
+            Work(*batch, l);
+        }
+        else {
+            m_cv.wait(l);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_FORK_JOIN_H
+#define LIBERA_FORK_JOIN_H
+
+#include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+/*******************************************************************************
+ * Runs batches of independent jobs on a fixed set of threads and the calling
+ * thread, returning when all jobs of the batch are done. Used to overlap
+ * remote round trips that would otherwise be made one after another.
+ * Batches of several callers are run at the same time, each caller keeps
+ * working on its own batch, so it never waits for the others.
+ */
+class LiberaForkJoin {
+public:
+    typedef std::function<void (size_t)> Job;
+
+    explicit LiberaForkJoin(size_t a_threads);
+    ~LiberaForkJoin();
+
+    void Run(size_t a_count, const Job &a_job, size_t a_limit = 0);
+    size_t GetSize() const { return m_threads.size(); }
+
+private:
+    LiberaForkJoin(const LiberaForkJoin &);
+    LiberaForkJoin &operator=(const LiberaForkJoin &);
+
+    struct Batch {
+        const Job         *job;
+        size_t             count;  // jobs in the batch
+        size_t             next;   // next job to be taken
+        size_t             active; // jobs being run
+        size_t             limit;  // max jobs run at once
+        std::exception_ptr error;  // first error of the batch
+    };
+
+    void Worker();
+    void Work(Batch &a_batch, std::unique_lock<std::mutex> &a_lock);
+
+    std::mutex               m_x;
+    std::condition_variable  m_cv;      // wakes workers on new jobs
+    std::condition_variable  m_done_cv; // signals job completion
+    bool                     m_running;
+    std::list<Batch *>       m_batches; // batches with jobs not taken yet
+    std::vector<std::thread> m_threads;
+};
+
+#endif //LIBERA_FORK_JOIN_H
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_HISTORY_H
+#define LIBERA_HISTORY_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ > 4)
+    #include <atomic>
+#else
+    #include <cstdatomic>
+#endif
+
+/**
+ * History counters. An overrun is a buffer that left the history before
+ * any client fetched it.
+ */
+struct LiberaHistoryStats {
+    uint64_t sequence;     // sequence number of the latest buffer
+    uint64_t overruns;     // buffers dropped unread
+    uint64_t droppedAtoms; // atoms in buffers dropped unread
+};
+
+/*******************************************************************************
+ * Fixed capacity history of acquired buffers, numbered with a sequence
+ * starting at 1. The writer pushes buffers it has filled and takes its next
+ * buffer from the spares, so the history is not copied on push and no
+ * buffer is allocated once the history is full. Clients get shared read
+ * only buffers, a buffer is reused only after all clients let it go.
+ */
+template <typename T>
+class LiberaHistory {
+public:
+    typedef std::shared_ptr<T> BufferPtr;
+
+    struct Entry {
+        uint64_t                 seq;
+        std::shared_ptr<const T> buf;
+    };
+
+    LiberaHistory()
+      : m_capacity(0),
+        m_seq(0),
+        m_first(0),
+        m_overruns(0),
+        m_droppedAtoms(0),
+        m_allocate(0)
+    {
+    }
+
+    /**
+     * Change history capacity, buffers stored so far are dropped. Spare
+     * buffers for the whole history are allocated by the writer on its
+     * next push.
+     */
+    void SetCapacity(size_t a_capacity)
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        m_capacity = a_capacity;
+        m_ring.assign(a_capacity, Slot());
+        m_spares.clear();
+        m_first = m_seq;
+        m_allocate = a_capacity ? a_capacity + 1 : 0;
+    }
+
+    size_t GetCapacity() const
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        return m_capacity;
+    }
+
+    /**
+     * Writer side: store filled buffer as the latest entry.
+     */
+    void Push(const BufferPtr &a_buf, size_t a_atoms)
+    {
+        Allocate(*a_buf);
+        std::lock_guard<std::mutex> l(m_x);
+        if (m_capacity == 0) {
+            return;
+        }
+        ++m_seq;
+        Slot &slot(m_ring[m_seq % m_capacity]);
+        if (slot.buf) {
+            if (!slot.read) {
+                ++m_overruns;
+                m_droppedAtoms += slot.atoms;
+            }
+            m_spares.push_back(slot.buf);
+        }
+        slot.seq = m_seq;
+        slot.buf = a_buf;
+        slot.atoms = a_atoms;
+        slot.read = false;
+    }
+
+    /**
+     * Writer side: buffer not referenced by the history or any client,
+     * empty if there is none.
+     */
+    BufferPtr Spare()
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        for (auto i = m_spares.begin(); i != m_spares.end(); ++i) {
+            if (i->unique()) {
+                BufferPtr buf(*i);
+                m_spares.erase(i);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return buf;
+            }
+        }
+        return BufferPtr();
+    }
+
+    /**
+     * Fetch up to a_count latest buffers, oldest first.
+     */
+    size_t GetLast(size_t a_count, std::vector<Entry> &a_out)
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        const uint64_t oldest(Oldest());
+        return Fetch(m_seq - std::min<uint64_t>(a_count, m_seq - oldest), a_out);
+    }
+
+    /**
+     * Fetch all buffers newer than a_seq, oldest first. Buffers that are
+     * no longer in the history are counted in a_missed.
+     */
+    size_t GetSince(uint64_t a_seq, std::vector<Entry> &a_out,
+        uint64_t &a_missed)
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        const uint64_t oldest(Oldest());
+        a_missed = a_seq < oldest ? oldest - a_seq : 0;
+        return Fetch(std::max(a_seq, oldest), a_out);
+    }
+
+    LiberaHistoryStats GetStats() const
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        LiberaHistoryStats stats;
+        stats.sequence = m_seq;
+        stats.overruns = m_overruns;
+        stats.droppedAtoms = m_droppedAtoms;
+        return stats;
+    }
+
+private:
+    struct Slot {
+        Slot() : seq(0), atoms(0), read(false) {}
+        uint64_t  seq;
+        BufferPtr buf;
+        size_t    atoms;
+        bool      read;
+    };
+
+    /**
+     * Sequence number preceding the oldest stored buffer.
+     */
+    uint64_t Oldest() const
+    {
+        return std::max(m_first, m_seq - std::min<uint64_t>(m_seq, m_capacity));
+    }
+
+    /**
+     * Copy entries after a_seq to a_out, must be called locked.
+     */
+    size_t Fetch(uint64_t a_seq, std::vector<Entry> &a_out)
+    {
+        a_out.clear();
+        for (uint64_t seq(a_seq + 1); seq <= m_seq; ++seq) {
+            Slot &slot(m_ring[seq % m_capacity]);
+            slot.read = true;
+            Entry e = { slot.seq, slot.buf };
+            a_out.push_back(e);
+        }
+        return a_out.size();
+    }
+
+    /**
+     * Allocate spares for the whole history at once after capacity change,
+     * copying the writer's buffer outside of the lock.
+     */
+    void Allocate(const T &a_proto)
+    {
+        size_t count;
+        {
+            std::lock_guard<std::mutex> l(m_x);
+            count = m_allocate;
+            m_allocate = 0;
+        }
+        if (count == 0) {
+            return;
+        }
+        std::vector<BufferPtr> bufs;
+        bufs.reserve(count);
+        for (size_t i(0); i != count; ++i) {
+            bufs.push_back(std::make_shared<T>(a_proto));
+        }
+        std::lock_guard<std::mutex> l(m_x);
+        m_spares.insert(m_spares.end(), bufs.begin(), bufs.end());
+    }
+
+    mutable std::mutex     m_x;
+    size_t                 m_capacity;
+    std::vector<Slot>      m_ring;
+    std::vector<BufferPtr> m_spares;
+    uint64_t               m_seq;
+    uint64_t               m_first; // sequence at last capacity change
+    uint64_t               m_overruns;
+    uint64_t               m_droppedAtoms;
+    size_t                 m_allocate; // spares to be allocated by writer
+};
+
+#endif //LIBERA_HISTORY_H
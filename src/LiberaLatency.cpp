@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include "LiberaLatency.h"
+
+const unsigned LiberaLatency::c_subBits;
+const size_t   LiberaLatency::c_sub;
+const unsigned LiberaLatency::c_maxBits;
+const size_t   LiberaLatency::c_buckets;
+
+std::atomic<bool> LiberaLatency::s_enabled(false);
+
+LiberaLatency::LiberaLatency()
+  : m_counts(NULL),
+    m_sumNs(0),
+    m_maxNs(0)
+{
+}
+
+LiberaLatency::~LiberaLatency()
+{
+    delete [] m_counts.load();
+}
+
+/**
+ * Enable or disable recording for all histograms of the process.
+ */
+void LiberaLatency::Enable(bool a_enable)
+{
+    s_enabled = a_enable;
+}
+
+/**
+ * Allocate the buckets on the first record. Concurrent first records race
+ * to install their array, the losers free theirs.
+ */
+std::atomic<uint64_t> *LiberaLatency::Allocate()
+{
+    std::atomic<uint64_t> *counts(new std::atomic<uint64_t>[c_buckets]);
+    for (size_t i(0); i < c_buckets; ++i) {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+    std::atomic<uint64_t> *expected(NULL);
+    if (!m_counts.compare_exchange_strong(expected, counts,
+            std::memory_order_acq_rel, std::memory_order_acquire)) {
+        delete [] counts;
+        return expected;
+    }
+    return counts;
+}
+
+void LiberaLatency::Reset()
+{
+    std::atomic<uint64_t> *counts(m_counts.load(std::memory_order_acquire));
+    if (counts) {
+        for (size_t i(0); i < c_buckets; ++i) {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    m_sumNs.store(0, std::memory_order_relaxed);
+    m_maxNs.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Largest latency counted in the bucket.
+ */
+uint64_t LiberaLatency::Upper(size_t a_index)
+{
+    if (a_index < 2 * c_sub) {
+        return a_index;
+    }
+    const unsigned shift(a_index / c_sub - 1);
+    const uint64_t mantissa(a_index % c_sub + c_sub);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/**
+ * Compute percentiles from a copy of the bucket counts, so records made
+ * meanwhile don't skew the result.
+ */
+LiberaLatencySummary LiberaLatency::GetSummary() const
+{
+    LiberaLatencySummary s = {};
+    const std::atomic<uint64_t> *buckets(m_counts.load(std::memory_order_acquire));
+    if (!buckets) {
+        return s; // nothing recorded yet
+    }
+    uint64_t counts[c_buckets];
+    uint64_t count(0);
+    for (size_t i(0); i < c_buckets; ++i) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        count += counts[i];
+    }
+
+    s.count = count;
+    s.maxNs = m_maxNs.load(std::memory_order_relaxed);
+    if (count == 0) {
+        return s;
+    }
+    s.meanNs = m_sumNs.load(std::memory_order_relaxed) / count;
+
+    const double fractions[] = { 0.5, 0.9, 0.99, 0.999 };
+    uint64_t *results[] = { &s.p50Ns, &s.p90Ns, &s.p99Ns, &s.p999Ns };
+    uint64_t seen(0);
+    size_t b(0);
+    for (size_t p(0); p < 4; ++p) {
+        const uint64_t rank(std::max<uint64_t>(1,
+            static_cast<uint64_t>(std::ceil(fractions[p] * count))));
+        while (b < c_buckets - 1 && seen + counts[b] < rank) {
+            seen += counts[b++];
+        }
+        *results[p] = std::min(Upper(b), s.maxNs);
+    }
+    return s;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_LATENCY_H
+#define LIBERA_LATENCY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ > 4)
+    #include <atomic>
+#else
+    #include <cstdatomic>
+#endif
+
+/**
+ * Latency percentiles in nanoseconds, percentiles are upper bounds of
+ * their histogram bucket.
+ */
+struct LiberaLatencySummary {
+    uint64_t count;
+    uint64_t meanNs;
+    uint64_t p50Ns;
+    uint64_t p90Ns;
+    uint64_t p99Ns;
+    uint64_t p999Ns;
+    uint64_t maxNs;
+};
+
+/*******************************************************************************
+ * Fixed size latency histogram with log-linear buckets: exact below 32 ns,
+ * then 16 buckets per power of two, which keeps the relative error of any
+ * percentile below 6.25%. Latencies from 2^36 ns (about a minute) on share
+ * the last bucket. Recording is lock free and may run concurrently with
+ * reading the summary. Recording is disabled by default and the buckets
+ * are allocated on the first record, so the many histograms that never
+ * record cost only a few words each.
+ */
+class LiberaLatency {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    LiberaLatency();
+    ~LiberaLatency();
+
+    static void Enable(bool a_enable);
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    void Record(uint64_t a_ns)
+    {
+        std::atomic<uint64_t> *counts(m_counts.load(std::memory_order_acquire));
+        if (!counts) {
+            counts = Allocate();
+        }
+        counts[Index(a_ns)].fetch_add(1, std::memory_order_relaxed);
+        m_sumNs.fetch_add(a_ns, std::memory_order_relaxed);
+        uint64_t max(m_maxNs.load(std::memory_order_relaxed));
+        while (a_ns > max && !m_maxNs.compare_exchange_weak(max, a_ns,
+                std::memory_order_relaxed)) {
+        }
+    }
+
+    LiberaLatencySummary GetSummary() const;
+    void Reset();
+
+    /**
+     * Records time spent in its scope, costs one relaxed load when
+     * recording is disabled.
+     */
+    class Scope {
+    public:
+        explicit Scope(LiberaLatency &a_latency)
+          : m_latency(IsEnabled() ? &a_latency : NULL)
+        {
+            if (m_latency) {
+                m_start = Clock::now();
+            }
+        }
+        ~Scope()
+        {
+            if (m_latency) {
+                m_latency->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - m_start).count());
+            }
+        }
+    private:
+        Scope(const Scope &);
+        Scope &operator=(const Scope &);
+
+        LiberaLatency    *m_latency;
+        Clock::time_point m_start;
+    };
+
+private:
+    LiberaLatency(const LiberaLatency &);
+    LiberaLatency &operator=(const LiberaLatency &);
+
+    static const unsigned c_subBits = 4;
+    static const size_t   c_sub = 1 << c_subBits; // buckets per power of two
+    static const unsigned c_maxBits = 36;
+    static const size_t   c_buckets = (c_maxBits - c_subBits + 1) * c_sub;
+
+    static size_t Index(uint64_t a_ns)
+    {
+        if (a_ns < 2 * c_sub) {
+            return a_ns;
+        }
+        if (a_ns >> c_maxBits) {
+            return c_buckets - 1;
+        }
+        const unsigned shift(63 - __builtin_clzll(a_ns) - c_subBits);
+        return (shift + 1) * c_sub + (a_ns >> shift) - c_sub;
+    }
+
+    static uint64_t Upper(size_t a_index);
+    std::atomic<uint64_t> *Allocate();
+
+    static std::atomic<bool> s_enabled;
+
+    std::atomic<std::atomic<uint64_t> *> m_counts; // c_buckets, allocated on demand
+    std::atomic<uint64_t> m_sumNs;
+    std::atomic<uint64_t> m_maxNs;
+};
+
+#endif //LIBERA_LATENCY_H
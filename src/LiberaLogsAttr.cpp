@@ -28,7 +28,7 @@ LiberaLogsAttr::~LiberaLogsAttr()
     delete [] m_attr;
 }
 
-void LiberaLogsAttr::Read(mci::Node &)
+void LiberaLogsAttr::Read()
 {
     //TODO
 }
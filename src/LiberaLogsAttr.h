@@ -19,7 +19,7 @@ public:
     LiberaLogsAttr(Tango::DevString *&a_attr, const size_t a_size);
     virtual ~LiberaLogsAttr();
 
-    virtual void Read(mci::Node &a_root);
+    virtual void Read();
     void Write(mci::Node &a_root, const Tango::DevString a_val);
 
 private:
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include <cstring>
+
+#include <istd/trace.h>
+#include <mci/mci.h>
+
+#include "LiberaNodes.h"
+
+LiberaNodes::LiberaNodes(const std::string &a_path)
+  : m_entry(LiberaPaths::Intern(a_path)),
+    m_resolved(false)
+{
+}
+
+/**
+ * Resolve all known handles against the new root node. Paths that can not be
+ * resolved now (e.g. the attribute path is only a prefix of the sub-nodes)
+ * are retried on access.
+ */
+void LiberaNodes::Resolve(mci::Node &a_root)
+{
+    istd_FTRC();
+    std::lock_guard<std::mutex> l(m_x);
+    m_root = a_root;
+    m_resolved = false;
+    if (m_entry->path.empty()) {
+        return;
+    }
+    try {
+        Lookup(m_entry, m_node, m_resolved);
+    }
+    catch (istd::Exception e)
+    {
+        istd_TRC(istd::eTrcDetail, "Node not resolved: " << GetPath());
+    }
+    for (auto i = m_derived.begin(); i != m_derived.end(); ++i) {
+        i->resolved = false;
+        try {
+            Lookup(i->entry, i->node, i->resolved);
+        }
+        catch (istd::Exception e)
+        {
+            istd_TRC(istd::eTrcDetail, "Node not resolved: " << i->entry->path);
+        }
+    }
+}
+
+/**
+ * Drop all handles, they are resolved again on next access.
+ */
+void LiberaNodes::Invalidate()
+{
+    std::lock_guard<std::mutex> l(m_x);
+    m_root = mci::Node();
+    m_node = mci::Node();
+    m_resolved = false;
+    for (auto i = m_derived.begin(); i != m_derived.end(); ++i) {
+        i->node = mci::Node();
+        i->resolved = false;
+    }
+}
+
+/**
+ * Return the node at the attribute path.
+ */
+mci::Node LiberaNodes::Get()
+{
+    std::lock_guard<std::mutex> l(m_x);
+    if (!m_resolved) {
+        Lookup(m_entry, m_node, m_resolved);
+    }
+    return m_node;
+}
+
+/**
+ * Return the node at the attribute path with the suffix appended.
+ */
+mci::Node LiberaNodes::Get(const char *a_suffix)
+{
+    std::lock_guard<std::mutex> l(m_x);
+    for (auto i = m_derived.begin(); i != m_derived.end(); ++i) {
+        if (std::strcmp(i->suffix, a_suffix) == 0) {
+            if (!i->resolved) {
+                Lookup(i->entry, i->node, i->resolved);
+            }
+            return i->node;
+        }
+    }
+    const LiberaPaths::Entry *entry(LiberaPaths::Derive(m_entry, a_suffix));
+    const char *suffix(entry->path.c_str() + GetPath().size());
+    Derived d = { suffix, entry, mci::Node(), false };
+    m_derived.push_back(d);
+    Derived &n(m_derived.back());
+    Lookup(n.entry, n.node, n.resolved);
+    return n.node;
+}
+
+/**
+ * Check if sub-nodes have been used, value then depends on several nodes.
+ */
+bool LiberaNodes::HasDerived()
+{
+    std::lock_guard<std::mutex> l(m_x);
+    return !m_derived.empty();
+}
+
+/**
+ * Resolve a single path, called with the lock held.
+ */
+void LiberaNodes::Lookup(const LiberaPaths::Entry *a_entry, mci::Node &a_node, bool &a_resolved)
+{
+    a_node = m_root.GetNode(a_entry->tokens);
+    a_resolved = true;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_NODES_H
+#define LIBERA_NODES_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <mci/node.h>
+
+#include "LiberaPaths.h"
+
+/*******************************************************************************
+ * Cache of ireg node handles used by one attribute.
+ * The node at the attribute path is resolved when the client connects and
+ * sub-nodes used by the reader and writer functions are resolved on their
+ * first access. All handles are kept until the connection is re-established,
+ * so the path is not tokenized and looked up again on every access.
+ * Paths are interned, the tokenized forms are shared by all attributes.
+ */
+class LiberaNodes {
+public:
+    explicit LiberaNodes(const std::string &a_path);
+
+    void Resolve(mci::Node &a_root);
+    void Invalidate();
+
+    mci::Node Get();
+    mci::Node Get(const char *a_suffix);
+
+    const std::string &GetPath() const { return m_entry->path; }
+    bool HasDerived();
+
+private:
+    /**
+     * Sub-node handle, the suffix is appended to the attribute path as is.
+     * The suffix points into the interned sub-node path.
+     */
+    struct Derived {
+        const char                *suffix;
+        const LiberaPaths::Entry  *entry;
+        mci::Node                  node;
+        bool                       resolved;
+    };
+
+    void Lookup(const LiberaPaths::Entry *a_entry, mci::Node &a_node, bool &a_resolved);
+
+    std::mutex                      m_x; // protects handles, used from several threads
+    const LiberaPaths::Entry *const m_entry;
+    mci::Node                       m_root;
+    mci::Node                       m_node;
+    bool                            m_resolved;
+    std::vector<Derived>            m_derived;
+};
+
+#endif //LIBERA_NODES_H
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include <mci/mci.h>
+
+#include "LiberaPaths.h"
+
+LiberaPaths::LiberaPaths()
+{
+}
+
+/**
+ * The table is created on first use and intentionally never destroyed, so
+ * it outlives static destruction of any attribute owner.
+ */
+LiberaPaths &LiberaPaths::Instance()
+{
+    static LiberaPaths *paths = new LiberaPaths();
+    return *paths;
+}
+
+/**
+ * Return entry of the path, adding it on first use.
+ */
+const LiberaPaths::Entry *LiberaPaths::Intern(const std::string &a_path)
+{
+    LiberaPaths &p(Instance());
+    std::lock_guard<std::mutex> l(p.m_x);
+    return p.Add(a_path);
+}
+
+/**
+ * Return entry of the path with the suffix appended as is.
+ */
+const LiberaPaths::Entry *LiberaPaths::Derive(const Entry *a_entry, const char *a_suffix)
+{
+    const std::string path(a_entry->path + a_suffix);
+    LiberaPaths &p(Instance());
+    std::lock_guard<std::mutex> l(p.m_x);
+    return p.Add(path);
+}
+
+size_t LiberaPaths::GetSize()
+{
+    LiberaPaths &p(Instance());
+    std::lock_guard<std::mutex> l(p.m_x);
+    return p.m_entries.size();
+}
+
+/**
+ * Find or add the path, called with the lock held.
+ */
+const LiberaPaths::Entry *LiberaPaths::Add(const std::string &a_path)
+{
+    auto i = m_index.find(a_path);
+    if (i != m_index.end()) {
+        return i->second;
+    }
+    Entry e = { a_path, a_path.empty() ? mci::Path() : mci::Tokenize(a_path) };
+    m_entries.push_back(e);
+    const Entry *entry(&m_entries.back());
+    m_index[a_path] = entry;
+    return entry;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_PATHS_H
+#define LIBERA_PATHS_H
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+
+#include <mci/node.h>
+
+/*******************************************************************************
+ * Process wide table of registry paths. Each distinct path is stored once
+ * together with its tokenized form, attributes and signals keep only a
+ * pointer to its entry. Devices with the same attribute layout share all
+ * entries. Entries are never removed or changed once added, so they are
+ * read without locking; only adding a path takes the lock.
+ */
+class LiberaPaths {
+public:
+    struct Entry {
+        std::string path;
+        mci::Path   tokens;
+    };
+
+    static const Entry *Intern(const std::string &a_path);
+    static const Entry *Derive(const Entry *a_entry, const char *a_suffix);
+    static size_t GetSize();
+
+private:
+    LiberaPaths();
+    static LiberaPaths &Instance();
+    const Entry *Add(const std::string &a_path);
+
+    std::mutex        m_x;
+    std::deque<Entry> m_entries; // stable on growth
+    std::unordered_map<std::string, const Entry *> m_index;
+};
+
+#endif //LIBERA_PATHS_H
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include <cmath>
+
+#include <istd/trace.h>
+
+#include "LiberaPollEngine.h"
+
+namespace {
+    // Number of poll threads shared by all clients. Poll cycles are short
+    // compared to the poll periods, so a few threads serve many devices;
+    // slow clients are given extra threads.
+    const size_t c_pollThreads(4);
+    // Number of threads reading attributes for the poll threads, together
+    // with the calling poll thread they overlap the registry round trips.
+    const size_t c_fetchThreads(4);
+}
+
+LiberaPollEngine::LiberaPollEngine(size_t a_threads)
+  : m_pool(a_threads),
+    m_fetch(c_fetchThreads),
+    m_registered(0)
+{
+    istd_FTRC();
+}
+
+/**
+ * Engine is created on first use and intentionally never destroyed, so it
+ * outlives static destruction of any client owner.
+ */
+LiberaPollEngine &LiberaPollEngine::Instance()
+{
+    static LiberaPollEngine *engine = new LiberaPollEngine(c_pollThreads);
+    return *engine;
+}
+
+/**
+ * Return poll phase for a new client as a fraction of the poll period.
+ * Phases follow the golden ratio sequence, which spreads any number of
+ * clients evenly over the period.
+ */
+double LiberaPollEngine::Register()
+{
+    const double golden(0.6180339887498949);
+    const uint64_t n(m_registered++);
+    double phase(n * golden);
+    return phase - std::floor(phase);
+}
+
+void LiberaPollEngine::Schedule(LiberaTask *a_task, Clock::time_point a_when)
+{
+    m_pool.Schedule(a_task, a_when);
+}
+
+/**
+ * Remove the client from the engine, waiting for its poll in progress.
+ */
+void LiberaPollEngine::Cancel(LiberaTask *a_task)
+{
+    m_pool.Cancel(a_task, true);
+}
+
+/**
+ * Give the client a thread of its own while its poll cycles are slow, or
+ * drop it. The reservation is dropped as well when the client is cancelled.
+ */
+void LiberaPollEngine::Reserve(LiberaTask *a_task, bool a_reserve)
+{
+    m_pool.Reserve(a_task, a_reserve);
+}
+
+/**
+ * Call a_job for indexes 0 to a_count - 1 on the fetch threads and the
+ * calling thread, returning when all calls are done. Fetches of several
+ * clients are run at the same time.
+ */
+void LiberaPollEngine::Fetch(size_t a_count, const LiberaForkJoin::Job &a_job)
+{
+    m_fetch.Run(a_count, a_job);
+}
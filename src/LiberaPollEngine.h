@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_POLL_ENGINE_H
+#define LIBERA_POLL_ENGINE_H
+
+#include <cstdint>
+
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ > 4)
+    #include <atomic>
+#else
+    #include <cstdatomic>
+#endif
+
+#include "LiberaWorkerPool.h"
+#include "LiberaForkJoin.h"
+
+/**
+ * Poll cost of one device, times in nanoseconds.
+ */
+struct LiberaPollStats {
+    uint64_t polls;   // poll cycles with at least one attribute due
+    uint64_t attrs;   // attributes read
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint64_t lastNs;
+};
+
+/*******************************************************************************
+ * Process wide polling engine shared by all clients of a device server.
+ * Client poll cycles are run on a bounded set of threads and each client
+ * gets its own phase within the poll periods, so devices registered
+ * together don't poll at the same time. Clients with slow poll cycles get
+ * an extra thread each while they are slow. Attribute reads of all clients
+ * share one set of fetch threads.
+ */
+class LiberaPollEngine {
+public:
+    typedef LiberaTask::Clock Clock;
+
+    static LiberaPollEngine &Instance();
+
+    double Register();
+    void Schedule(LiberaTask *a_task, Clock::time_point a_when);
+    void Cancel(LiberaTask *a_task);
+    void Reserve(LiberaTask *a_task, bool a_reserve);
+    void Fetch(size_t a_count, const LiberaForkJoin::Job &a_job);
+    size_t GetThreads() const { return m_pool.GetSize(); } // slow clients included
+
+private:
+    explicit LiberaPollEngine(size_t a_threads);
+
+    LiberaWorkerPool      m_pool;
+    LiberaForkJoin        m_fetch;
+    std::atomic<uint64_t> m_registered;
+};
+
+#endif //LIBERA_POLL_ENGINE_H
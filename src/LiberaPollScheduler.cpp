@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include <algorithm>
+
+#include "LiberaPollScheduler.h"
+
+const uint32_t LiberaPollScheduler::c_minPeriod;
+
+LiberaPollScheduler::LiberaPollScheduler()
+{
+}
+
+/**
+ * Heap ordering, the class with the earliest deadline is on top.
+ */
+bool LiberaPollScheduler::Later(const PollClass *a, const PollClass *b)
+{
+    return a->deadline > b->deadline;
+}
+
+/**
+ * Add attribute to the class with given period, new class is due immediately.
+ * Periods below c_minPeriod are raised to it, a zero period would make the
+ * class due again as soon as it is read.
+ */
+void LiberaPollScheduler::Add(LiberaAttr *a_attr, uint32_t a_period)
+{
+    a_period = std::max(a_period, c_minPeriod);
+    auto i = m_classes.find(a_period);
+    if (i == m_classes.end()) {
+        PollClass &c(m_classes[a_period]);
+        c.period = std::chrono::milliseconds(a_period);
+        c.deadline = Clock::now();
+        c.attr.push_back(a_attr);
+        m_heap.push_back(&c);
+        std::push_heap(m_heap.begin(), m_heap.end(), Later);
+    }
+    else {
+        i->second.attr.push_back(a_attr);
+    }
+}
+
+/**
+ * Remove attribute from its class, classes left empty are dropped.
+ */
+void LiberaPollScheduler::Remove(LiberaAttr *a_attr)
+{
+    for (auto i = m_classes.begin(); i != m_classes.end(); ++i) {
+        AttrList &l(i->second.attr);
+        auto a = std::find(l.begin(), l.end(), a_attr);
+        if (a != l.end()) {
+            l.erase(a);
+            if (l.empty()) {
+                m_classes.erase(i);
+                Rebuild();
+            }
+            return;
+        }
+    }
+}
+
+/**
+ * Restart all classes, used when (re)connected. Each class is first due
+ * a_phase of its period after a_now, phases between 0 and 1 spread polling
+ * of several clients over the period.
+ */
+void LiberaPollScheduler::Start(Clock::time_point a_now, double a_phase)
+{
+    for (auto i = m_classes.begin(); i != m_classes.end(); ++i) {
+        PollClass &c(i->second);
+        c.deadline = a_now + std::chrono::duration_cast<Clock::duration>(
+            c.period * a_phase);
+    }
+    Rebuild();
+}
+
+/**
+ * Return the attributes of the earliest class if it is due and advance its
+ * deadline by one period. Deadlines missed by more than one period are not
+ * caught up, the class is next due one period from now. Called repeatedly
+ * with the same a_now, each class is returned at most once.
+ * Returns NULL when nothing is due.
+ */
+const LiberaPollScheduler::AttrList *LiberaPollScheduler::Next(Clock::time_point a_now)
+{
+    if (m_heap.empty() || m_heap.front()->deadline > a_now) {
+        return NULL;
+    }
+    std::pop_heap(m_heap.begin(), m_heap.end(), Later);
+    PollClass *c(m_heap.back());
+    c->deadline += c->period;
+    if (c->deadline <= a_now) {
+        c->deadline = a_now + c->period;
+    }
+    std::push_heap(m_heap.begin(), m_heap.end(), Later);
+    m_taken.push_back(c);
+    return &c->attr;
+}
+
+/**
+ * Complete the poll cycle of the classes returned by Next. A class that
+ * took longer to read than its period is next due one period after a_now,
+ * instead of being due again immediately.
+ */
+void LiberaPollScheduler::Done(Clock::time_point a_now)
+{
+    bool overrun(false);
+    for (auto i = m_taken.begin(); i != m_taken.end(); ++i) {
+        if ((*i)->deadline <= a_now) {
+            (*i)->deadline = a_now + (*i)->period;
+            overrun = true;
+        }
+    }
+    m_taken.clear();
+    if (overrun) {
+        std::make_heap(m_heap.begin(), m_heap.end(), Later);
+    }
+}
+
+/**
+ * Time when the next class is due.
+ */
+LiberaPollScheduler::Clock::time_point LiberaPollScheduler::GetDeadline() const
+{
+    if (m_heap.empty()) {
+        return Clock::now() + std::chrono::milliseconds(ePollNormal);
+    }
+    return m_heap.front()->deadline;
+}
+
+void LiberaPollScheduler::Rebuild()
+{
+    m_taken.clear();
+    m_heap.clear();
+    for (auto i = m_classes.begin(); i != m_classes.end(); ++i) {
+        m_heap.push_back(&i->second);
+    }
+    std::make_heap(m_heap.begin(), m_heap.end(), Later);
+}
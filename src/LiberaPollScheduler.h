@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_POLL_SCHEDULER_H
+#define LIBERA_POLL_SCHEDULER_H
+
+#include <chrono>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+class LiberaAttr;
+
+/**
+ * Predefined attribute poll periods in milliseconds. Any other period can be
+ * used as well, attributes with equal period are polled together.
+ */
+enum LiberaPollPeriod_e {
+    ePollFast   = 100,   // interlock and status flags
+    ePollNormal = 2000,  // default
+    ePollSlow   = 10000  // temperatures, fans, ...
+};
+
+/*******************************************************************************
+ * Deadline scheduler for attribute polling. Attributes are grouped in classes
+ * by poll period and each class is due on its own deadline. The classes are
+ * kept in a heap ordered by deadline, so the earliest one is always on top.
+ */
+class LiberaPollScheduler {
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::vector<LiberaAttr *> AttrList;
+
+    static const uint32_t c_minPeriod = 1; // shorter periods are raised, ms
+
+    LiberaPollScheduler();
+
+    void Add(LiberaAttr *a_attr, uint32_t a_period);
+    void Remove(LiberaAttr *a_attr);
+    void Start(Clock::time_point a_now, double a_phase = 0);
+    const AttrList *Next(Clock::time_point a_now);
+    void Done(Clock::time_point a_now);
+    Clock::time_point GetDeadline() const;
+
+private:
+    struct PollClass {
+        std::chrono::milliseconds period;
+        Clock::time_point         deadline;
+        AttrList                  attr;
+    };
+    static bool Later(const PollClass *a, const PollClass *b);
+    void Rebuild();
+
+    std::map<uint32_t, PollClass> m_classes; // by period in ms
+    std::vector<PollClass *>      m_heap;    // by deadline, earliest first
+    std::vector<PollClass *>      m_taken;   // returned by Next since Done
+};
+
+#endif //LIBERA_POLL_SCHEDULER_H
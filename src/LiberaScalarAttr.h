@@ -12,6 +12,9 @@
 #include <tango.h>
 #pragma GCC diagnostic warning "-Wold-style-cast"
 
+#include <future>
+#include <mutex>
+
 #include <istd/trace.h>
 #include <mci/mci.h>
 #include <mci/node.h>
@@ -74,45 +77,69 @@ public:
      * be empty
      */
     LiberaScalarAttr(const std::string a_path, TangoType *&a_attr,
-        TangoType (*a_reader)(mci::Node &, const std::string &),
-        void (*a_writer)(mci::Node &, const std::string &, const TangoType))
+        TangoType (*a_reader)(LiberaNodes &),
+        void (*a_writer)(LiberaNodes &, const TangoType))
       : LiberaAttr(),
         m_attr(a_attr),
-        m_path(a_path),
+        m_nodes(a_path),
         m_reader(a_reader),
-        m_writer(a_writer)
+        m_writer(a_writer),
+        m_fetched(false),
+        m_pending(false)
     {
         m_attr = new TangoType;
-        if (m_path.empty()) {
+        if (GetPath().empty()) {
             *m_attr = 0;
         }
     }
     virtual ~LiberaScalarAttr()
     {
         delete m_attr;
-        istd_TRC(istd::eTrcDetail, "Destroyed scalar attribute for: " << m_path);
+        istd_TRC(istd::eTrcDetail, "Destroyed scalar attribute for: " << GetPath());
     }
 
     /**
      * Default reader function gets value from registry.
      */
-    static TangoType DoRead(mci::Node &a_root, const std::string &a_path) {
+    static TangoType DoRead(LiberaNodes &a_nodes) {
         istd_FTRC();
         LiberaType val;
-        a_root.GetNode(mci::Tokenize(a_path)).Get(val);
+        a_nodes.Get().Get(val);
         return val;
     }
 
+    /**
+     * Resolve node handles against the new root node.
+     */
+    virtual void Resolve(mci::Node &a_root) {
+        m_nodes.Resolve(a_root);
+    }
+
+    virtual void Invalidate() {
+        m_nodes.Invalidate();
+    }
+
+    /**
+     * Only attributes read from a single node can be updated on notification.
+     * Reader functions combining sub-nodes are known after the first read.
+     */
+    virtual mci::Node GetNotifyNode() {
+        if (GetPath().empty() || m_nodes.HasDerived()) {
+            return mci::Node();
+        }
+        return m_nodes.Get();
+    }
+
     /**
      * Call the reader function and notify client if value has changed.
      */
-    virtual void Read(mci::Node &a_root) {
+    virtual void Read() {
         istd_FTRC();
-        if (!m_path.empty()) {
-            istd_TRC(istd::eTrcDetail, "Read from node: " << m_path);
-            TangoType val = m_reader(a_root, m_path);
-            // poor man's notification client
-            // could also use mci::NotificationClient
+        if (!GetPath().empty()) {
+            istd_TRC(istd::eTrcDetail, "Read from node: " << GetPath());
+            LiberaLatency::Scope t(m_readLatency);
+            TangoType val = m_reader(m_nodes);
+            // called on poll or on registry change notification
             if (*m_attr != val) {
                 *m_attr = val;
                 Notify();
@@ -120,13 +147,45 @@ public:
         }
     }
 
+    /**
+     * Call the reader function, the value is stored by Apply.
+     */
+    virtual void Fetch() {
+        if (!GetPath().empty()) {
+            LiberaLatency::Scope t(m_readLatency);
+            m_value = m_reader(m_nodes);
+            m_fetched = true;
+        }
+    }
+
+    /**
+     * Store the fetched value and notify client if it has changed.
+     */
+    virtual void Apply() {
+        if (m_fetched) {
+            m_fetched = false;
+            if (*m_attr != m_value) {
+                *m_attr = m_value;
+                Notify();
+            }
+        }
+    }
+
+    virtual const std::string &GetName() const {
+        return GetPath();
+    }
+
+    virtual void Discard() {
+        m_fetched = false;
+    }
+
     /**
      * Default writer function puts value to registry node.
      */
-    static void DoWrite(mci::Node &a_root, const std::string &a_path, const TangoType a_val) {
+    static void DoWrite(LiberaNodes &a_nodes, const TangoType a_val) {
         istd_FTRC();
         LiberaType val(a_val);
-        a_root.GetNode(mci::Tokenize(a_path)).Set(val);
+        a_nodes.Get().Set(val);
     }
 
     /**
@@ -140,27 +199,107 @@ public:
      */
 
     /**
-     * Call the writer function.
+     * Call the writer function. A pending asynchronous write is dropped and
+     * completes with the result of this one, since it would overwrite the
+     * value later.
      */
-    void Write(mci::Node &a_root, const TangoType a_val) {
-        if (!m_path.empty()) {
-        	istd_TRC(istd::eTrcDetail, "Write to node: " << m_path);
-            m_writer(a_root, m_path, a_val);
-            *m_attr = a_val;
+    void Write(const TangoType a_val) {
+        std::lock_guard<std::mutex> o(m_order_x);
+        std::promise<void> done;
+        bool pending;
+        {
+            std::lock_guard<std::mutex> l(m_write_x);
+            pending = m_pending;
+            if (pending) {
+                m_pending = false;
+                done = std::move(m_promise);
+            }
+        }
+        try {
+            WriteNode(a_val);
+        }
+        catch (...) {
+            if (pending) {
+                done.set_exception(std::current_exception());
+            }
+            throw;
+        }
+        if (pending) {
+            done.set_value();
         }
     }
 
     /**
-     * The attribute memory address is used as handle since it doesn't change
-     * in object's lifetime.
+     * Set value to be written asynchronously, replacing a value not written
+     * yet. All writes coalesced into one complete with the same future.
+     * Returns true if the attribute has to be queued for Flush.
      */
-    bool IsEqual(TangoType *&a_attr) { return a_attr == m_attr; }
+    bool WriteLater(const TangoType a_val, std::shared_future<void> &a_done) {
+        std::lock_guard<std::mutex> l(m_write_x);
+        m_pendingVal = a_val;
+        const bool queue(!m_pending);
+        if (queue) {
+            m_promise = std::promise<void>();
+            m_done = m_promise.get_future().share();
+            m_pending = true;
+        }
+        a_done = m_done;
+        return queue;
+    }
+
+    /**
+     * Write the pending value and complete its future. Errors are passed to
+     * the future and rethrown.
+     */
+    virtual void Flush() {
+        std::lock_guard<std::mutex> o(m_order_x);
+        std::promise<void> done;
+        TangoType val;
+        {
+            std::lock_guard<std::mutex> l(m_write_x);
+            if (!m_pending) {
+                return;
+            }
+            m_pending = false;
+            val = m_pendingVal;
+            done = std::move(m_promise);
+        }
+        try {
+            WriteNode(val);
+            done.set_value();
+        }
+        catch (...) {
+            done.set_exception(std::current_exception());
+            throw;
+        }
+    }
 
 private:
+    const std::string &GetPath() const { return m_nodes.GetPath(); }
+
+    void WriteNode(const TangoType a_val) {
+        if (!GetPath().empty()) {
+        	istd_TRC(istd::eTrcDetail, "Write to node: " << GetPath());
+            LiberaLatency::Scope t(m_writeLatency);
+            m_writer(m_nodes, a_val);
+            *m_attr = a_val;
+        }
+    }
+
     TangoType *&m_attr;
-    const std::string m_path;
-    TangoType (*m_reader)(mci::Node &, const std::string &);
-    void (*m_writer)(mci::Node &, const std::string &, const TangoType);
+    LiberaNodes m_nodes;
+    TangoType (*m_reader)(LiberaNodes &);
+    void (*m_writer)(LiberaNodes &, const TangoType);
+    TangoType m_value;   // fetched, not yet applied
+    bool      m_fetched;
+
+    // asynchronous write waiting in the write queue
+    std::mutex               m_order_x; // writes reach the node in order
+    std::mutex               m_write_x;
+    bool                     m_pending;
+    TangoType                m_pendingVal;
+    std::promise<void>       m_promise;
+    std::shared_future<void> m_done;
 };
 
 #endif //LIBERA_SCALAR_ATTR_H
@@ -6,6 +6,7 @@
  */
 
 #include <chrono>
+#include <algorithm>
 
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 #include <tango.h>
@@ -18,16 +19,30 @@
 
 #include "LiberaSignal.h"
 
+namespace {
+    // Number of signal worker threads for acquisitions that return
+    // immediately. Signals waiting for data get a thread of their own on
+    // top of these while they are enabled.
+    size_t s_poolSize(4);
+}
+
 LiberaSignal::LiberaSignal(const std::string &a_path, size_t a_length,
     Tango::DevBoolean *&a_enabled, Tango::DevLong *&a_bufSize)
-  : m_running(false),
-    m_thread(),
-    m_period(2000),
+  : m_period(2000),
+    m_lastRun(0),
     m_enabled(a_enabled),
     m_length(a_bufSize),
     m_connected(false),
+    m_stream(false),
     m_mode(isig::eModeDodNow),
-    m_path(a_path)
+    m_dodOpens(0),
+    m_dodReuses(0),
+    m_dodOpenNs(0),
+    m_path(LiberaPaths::Intern(a_path)),
+    m_hasStats(false),
+    m_statsFresh(false),
+    m_callback(NULL),
+    m_callback_arg(NULL)
 {
     istd_FTRC();
     m_enabled = new Tango::DevBoolean;
@@ -35,12 +50,6 @@ LiberaSignal::LiberaSignal(const std::string &a_path, size_t a_length,
 
     m_length = new Tango::DevLong;
     *m_length = a_length;
-
-    m_thread = std::thread(std::ref(*this));
-    // safety check, wait that thread function has started
-    while (!m_running) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    };
 }
 
 LiberaSignal::~LiberaSignal()
@@ -49,7 +58,44 @@ LiberaSignal::~LiberaSignal()
     Stop();
     delete m_enabled;
     delete m_length;
-    istd_TRC(istd::eTrcDetail, "Destroyed base signal for: " << m_path);
+    for (auto i = m_stats.begin(); i != m_stats.end(); ++i) {
+        delete i->mean;
+        delete i->std;
+        delete i->min;
+        delete i->max;
+        delete i->p2p;
+    }
+    istd_TRC(istd::eTrcDetail, "Destroyed base signal for: " << GetPath());
+}
+
+/**
+ * Set base number of signal worker threads, must be called before the first
+ * signal is created.
+ */
+void LiberaSignal::SetPoolSize(size_t a_threads)
+{
+    s_poolSize = a_threads;
+}
+
+/**
+ * Worker pool shared by all signals in the process. It is created on first
+ * use and intentionally never destroyed, so it outlives static destruction
+ * of any signal owner.
+ */
+LiberaWorkerPool &LiberaSignal::GetPool()
+{
+    static LiberaWorkerPool *pool = new LiberaWorkerPool(s_poolSize);
+    return *pool;
+}
+
+/**
+ * Stream reads and data on demand reads waiting for a trigger block until
+ * data arrives, so the signal reserves a worker thread while it is enabled.
+ */
+void LiberaSignal::UpdateReservation()
+{
+    const bool blocking(m_stream || m_mode != isig::eModeDodNow);
+    GetPool().Reserve(this, *m_enabled && blocking);
 }
 
 /**
@@ -59,67 +105,62 @@ LiberaSignal::~LiberaSignal()
 void LiberaSignal::Stop()
 {
     istd_FTRC();
-    m_running = false;
-    if (m_thread.joinable()) {
-        m_thread.join();
-    }
+    GetPool().Cancel(this, true);
 }
 
 /**
- * This is internal thread for continuous acquisition. The UpdateSignal method
- * is implemented in derived class.
+ * One acquisition step for continuous acquisition, called from the worker
+ * pool. The UpdateSignal method is implemented in derived class.
  */
-void LiberaSignal::operator()()
+bool LiberaSignal::Run(Clock::time_point &a_next)
 {
     istd_FTRC();
-    // thread function has started
-    m_running = true;
-    while (m_running) {
-        if (*m_enabled && m_connected) {
-            istd_TRC(istd::eTrcDetail, "Update from thread for: " << m_path);
-
-            try {
-                Update();
-                if (m_mode == isig::eModeDodNow) {
-                    // In order to avoid busy loop the dod acquisition with
-                    // eModeDodNow waits here, since Read() is immediate.
-                    std::this_thread::sleep_for(std::chrono::milliseconds(m_period));
-                }
-            }
-            catch (istd::Exception e) {
-                istd_TRC(istd::eTrcLow, "istd::Exception: " << e.what());
-            }
-            catch (Tango::DevFailed& e) {
-                istd_TRC(istd::eTrcLow, "DevFailed Tango exception: " << e._name());
-            }
-            catch (Tango::MultiDevFailed& e) {
-                istd_TRC(istd::eTrcLow, "MultiDevFailed Tango exception: " << e._name());
-            }
-            catch (CORBA::UserException& e) {
-                istd_TRC(istd::eTrcLow, "CORBA::UserException exception: " << e._name());
-            }
-            catch (CORBA::Exception& e) {
-                istd_TRC(istd::eTrcLow, "CORBA::Exception exception: " << e._name());
-            }
-            catch (std::exception &e) {
-                istd_TRC(istd::eTrcLow, "istd::Exception: " << e.what());
-            }
-            catch (...) {
-                istd_TRC(istd::eTrcLow, "unknown exception was detected");
-            }
+    if (*m_enabled && m_connected) {
+        istd_TRC(istd::eTrcDetail, "Update from worker for: " << GetPath());
+        m_lastRun = Clock::now().time_since_epoch().count();
+
+        try {
+            Update();
+        }
+        catch (istd::Exception e) {
+            istd_TRC(istd::eTrcLow, "istd::Exception: " << e.what());
+        }
+        catch (Tango::DevFailed& e) {
+            istd_TRC(istd::eTrcLow, "DevFailed Tango exception: " << e._name());
         }
-        else {
-            // wait for stop running
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        catch (Tango::MultiDevFailed& e) {
+            istd_TRC(istd::eTrcLow, "MultiDevFailed Tango exception: " << e._name());
         }
+        catch (CORBA::UserException& e) {
+            istd_TRC(istd::eTrcLow, "CORBA::UserException exception: " << e._name());
+        }
+        catch (CORBA::Exception& e) {
+            istd_TRC(istd::eTrcLow, "CORBA::Exception exception: " << e._name());
+        }
+        catch (std::exception &e) {
+            istd_TRC(istd::eTrcLow, "istd::Exception: " << e.what());
+        }
+        catch (...) {
+            istd_TRC(istd::eTrcLow, "unknown exception was detected");
+        }
+    }
+    a_next = Clock::now();
+    if (m_mode == isig::eModeDodNow) {
+        // In order to avoid busy loop the dod acquisition with
+        // eModeDodNow is rescheduled after period, since Read() is immediate.
+        a_next += std::chrono::milliseconds(m_period);
+    }
+    if (!*m_enabled || !m_connected) {
+        Suspend();
+        return false;
     }
-    istd_TRC(istd::eTrcHigh, "Exit update thread for: " << m_path);
+    return true;
 }
 
 /**
- * Public method for data acquisition called either from the internal thread or
- * directly to read signal data. It will disable signal and disconnect in case
- * of error.
+ * Public method for data acquisition called either from the worker pool or
+ * directly to read signal data. It disconnects the signal in case of error,
+ * the enabled state is kept so acquisition resumes when it is reconnected.
  */
 void LiberaSignal::Update()
 {
@@ -132,9 +173,12 @@ void LiberaSignal::Update()
     }
     catch (istd::Exception e)
     {
-        istd_TRC(istd::eTrcLow, "Exception thrown while reading signal: " << m_path);
+        istd_TRC(istd::eTrcLow, "Exception thrown while reading signal: " << GetPath());
         istd_TRC(istd::eTrcLow, e.what());
-        Disable();
+        {
+            std::lock_guard<std::mutex> l(m_error_x);
+            m_error = e.what();
+        }
         m_connected = false;
     }
 }
@@ -146,23 +190,52 @@ bool LiberaSignal::Connect(mci::Node &a_root)
 {
     istd_FTRC();
     m_connected = false;
+    // wait for acquisition in progress before replacing the clients
+    GetPool().Cancel(this, true);
     m_root = a_root;
     try {
-        mci::Node sNode = m_root.GetNode(mci::Tokenize(m_path));
+        mci::Node sNode = m_root.GetNode(m_path->tokens);
         Initialize(sNode);
+        UpdateReservation();
+        {
+            std::lock_guard<std::mutex> l(m_error_x);
+            m_error.clear();
+        }
         m_connected = true;
+        if (*m_enabled) {
+            GetPool().Schedule(this, Clock::now());
+        }
     }
     catch (istd::Exception e)
     {
-        istd_TRC(istd::eTrcLow, "Exception thrown while connecting signal: " << m_path);
+        istd_TRC(istd::eTrcLow, "Exception thrown while connecting signal: " << GetPath());
         istd_TRC(istd::eTrcLow, e.what());
+        std::lock_guard<std::mutex> l(m_error_x);
+        m_error = e.what();
     }
     return m_connected;
 }
 
+/**
+ * Reason of the last connection loss, empty if connected.
+ */
+std::string LiberaSignal::GetError()
+{
+    std::lock_guard<std::mutex> l(m_error_x);
+    return m_error;
+}
+
+/**
+ * Mode change takes effect immediately, a waiting eModeDodNow acquisition
+ * is not delayed until its period expires.
+ */
 void LiberaSignal::SetMode(isig::AccessMode_e  a_mode)
 {
     m_mode = a_mode;
+    UpdateReservation();
+    if (*m_enabled && m_connected) {
+        GetPool().Schedule(this, Clock::now());
+    }
 }
 
 isig::AccessMode_e LiberaSignal::GetMode()
@@ -173,16 +246,40 @@ isig::AccessMode_e LiberaSignal::GetMode()
 void LiberaSignal::Enable()
 {
     *m_enabled = true;
+    UpdateReservation();
+    if (m_connected) {
+        GetPool().Schedule(this, Clock::now());
+    }
 }
 
+/**
+ * Acquisition is stopped by the worker, which also releases the client
+ * session held by the signal.
+ */
 void LiberaSignal::Disable()
 {
     *m_enabled = false;
+    UpdateReservation();
+    if (m_connected) {
+        GetPool().Schedule(this, Clock::now());
+    }
+    else {
+        GetPool().Cancel(this, false);
+    }
 }
 
+/**
+ * Period change takes effect immediately, the next eModeDodNow acquisition
+ * is rescheduled one new period after the last one.
+ */
 void LiberaSignal::SetPeriod(uint32_t a_period)
 {
     m_period = a_period;
+    if (*m_enabled && m_connected && m_mode == isig::eModeDodNow) {
+        Clock::time_point next(Clock::duration(m_lastRun.load()));
+        next += std::chrono::milliseconds(a_period);
+        GetPool().Schedule(this, std::max(next, Clock::now()));
+    }
 }
 
 size_t LiberaSignal::GetLength()
@@ -195,8 +292,110 @@ void LiberaSignal::SetLength(size_t a_length)
     *m_length = a_length;
 }
 
+/**
+ * Called by the derived class on Initialize, stream reads always wait for
+ * data.
+ */
+void LiberaSignal::SetStream(bool a_stream)
+{
+    m_stream = a_stream;
+}
+
 void LiberaSignal::SetNotifier(SignalCallback a_callback, void *a_arg)
 {
     m_callback = a_callback;
     m_callback_arg = a_arg;
 }
+
+const std::string &LiberaSignal::GetPath() const
+{
+    return m_path->path;
+}
+
+LiberaDodStats LiberaSignal::GetDodStats() const
+{
+    LiberaDodStats stats;
+    stats.opens = m_dodOpens;
+    stats.reuses = m_dodReuses;
+    stats.openNs = m_dodOpenNs;
+    return stats;
+}
+
+void LiberaSignal::CountDodOpen(Clock::duration a_latency)
+{
+    ++m_dodOpens;
+    m_dodOpenNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        a_latency).count();
+}
+
+void LiberaSignal::CountDodReuse()
+{
+    ++m_dodReuses;
+}
+
+/**
+ * Add statistics of atom component a_column as scalar attributes. The
+ * values are allocated by the signal and computed with every acquisition,
+ * so clients can read a few scalars instead of the whole spectrum. They
+ * are stored to the attributes by ApplyStatistics.
+ */
+void LiberaSignal::AddStatistics(size_t a_column, Tango::DevDouble *&a_mean,
+    Tango::DevDouble *&a_std, Tango::DevDouble *&a_min,
+    Tango::DevDouble *&a_max, Tango::DevDouble *&a_p2p)
+{
+    StatAttr attr = {};
+    attr.column = a_column;
+    attr.mean = a_mean = new Tango::DevDouble(0);
+    attr.std = a_std = new Tango::DevDouble(0);
+    attr.min = a_min = new Tango::DevDouble(0);
+    attr.max = a_max = new Tango::DevDouble(0);
+    attr.p2p = a_p2p = new Tango::DevDouble(0);
+
+    std::lock_guard<std::mutex> l(m_stats_x);
+    m_stats.push_back(attr);
+    m_hasStats = true;
+}
+
+bool LiberaSignal::HasStatistics() const
+{
+    return m_hasStats;
+}
+
+/**
+ * Keep computed column statistics until they are applied, called from the
+ * worker.
+ */
+void LiberaSignal::SetStatistics(const LiberaColumnStats *a_stats, size_t a_cols)
+{
+    std::lock_guard<std::mutex> l(m_stats_x);
+    for (auto i = m_stats.begin(); i != m_stats.end(); ++i) {
+        if (i->column < a_cols) {
+            i->value = a_stats[i->column];
+        }
+    }
+    m_statsFresh = true;
+}
+
+/**
+ * Copy the latest statistics to their scalar attributes. Called by GetData,
+ * devices reading only the statistics attributes call it from their Tango
+ * read method, so the attributes are not written while Tango reads them.
+ */
+void LiberaSignal::ApplyStatistics()
+{
+    if (!m_hasStats) {
+        return;
+    }
+    std::lock_guard<std::mutex> l(m_stats_x);
+    if (!m_statsFresh) {
+        return;
+    }
+    m_statsFresh = false;
+    for (auto i = m_stats.begin(); i != m_stats.end(); ++i) {
+        *i->mean = i->value.mean;
+        *i->std = i->value.std;
+        *i->min = i->value.min;
+        *i->max = i->value.max;
+        *i->p2p = i->value.p2p;
+    }
+}
@@ -10,6 +10,7 @@
 
 #include <thread>
 #include <mutex>
+#include <vector>
 
 #if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ > 4)
     #include <atomic>
@@ -19,56 +20,144 @@
 
 #include <mci/node.h>
 
+#include "LiberaWorkerPool.h"
+#include "LiberaPaths.h"
+#include "LiberaHistory.h"
+#include "LiberaStatistics.h"
+#include "LiberaDecimate.h"
+#include "LiberaLatency.h"
+
 typedef void (*SignalCallback)(void *);
 
+/**
+ * Data on demand session counters. Each open costs a round trip to the
+ * signal server, reads on an already open session avoid it.
+ */
+struct LiberaDodStats {
+    uint64_t opens;  // sessions opened
+    uint64_t reuses; // reads without reopening
+    uint64_t openNs; // total time spent reopening
+
+    /**
+     * Estimated time saved by reusing sessions, in nanoseconds.
+     */
+    uint64_t SavedNs() const
+    {
+        return opens ? reuses * (openNs / opens) : 0;
+    }
+};
+
 /*******************************************************************************
  * Base abstract signal class for reading streams and dod.
+ * Enabled signals are acquired by the process wide signal worker pool,
+ * which keeps a thread for each enabled signal that waits for data.
  */
-class LiberaSignal {
+class LiberaSignal : public LiberaTask {
 public:
+    /**
+     * Latency histograms kept by each signal.
+     */
+    enum Latency_e {
+        eLatencyStream,  // stream read and publish
+        eLatencyDod,     // data on demand read and publish
+        eLatencyGetData, // copy of published data to the attributes
+        eLatencyCount
+    };
+
     LiberaSignal(const std::string &a_path, const size_t a_length,
         Tango::DevBoolean *&a_enabled, Tango::DevLong *&a_bufSize);
     virtual ~LiberaSignal();
 
+    static void SetPoolSize(size_t a_threads);
+
     bool Connect(mci::Node &a_root);
     void Enable();
     void Disable();
     void SetPeriod(uint32_t a_period);
-    void operator ()();
+    virtual bool Run(Clock::time_point &a_next);
     void Update();
     void SetMode(isig::AccessMode_e  a_mode);
 
     void SetNotifier(SignalCallback a_callback, void *a_arg);
 
+    void AddStatistics(size_t a_column, Tango::DevDouble *&a_mean,
+        Tango::DevDouble *&a_std, Tango::DevDouble *&a_min,
+        Tango::DevDouble *&a_max, Tango::DevDouble *&a_p2p);
+    void ApplyStatistics();
+
+    const std::string &GetPath() const;
+    bool IsConnected() const { return m_connected; }
+    std::string GetError();
+    LiberaDodStats GetDodStats() const;
+    LiberaLatency &GetLatency(Latency_e a_which) { return m_latency[a_which]; }
+
     // interface functions for the derived class
     virtual void SetOffset(int32_t a_offset) = 0;
     virtual void Realloc(size_t a_length) = 0;
     virtual bool IsUpdated() = 0;
     virtual void ClearUpdated() = 0;
     virtual void GetData() = 0;
+    virtual void SetHistory(size_t a_capacity) = 0;
+    virtual void SetDecimation(LiberaDecimation_e a_type, size_t a_factor) = 0;
+    virtual size_t GetOutputLength() = 0;
+    virtual LiberaHistoryStats GetHistoryStats() = 0;
 
 protected:
     virtual int32_t    GetOffset() = 0;
     isig::AccessMode_e GetMode();
     size_t GetLength();
     void   SetLength(size_t a_length);
+    void   SetStream(bool a_stream);
     void   Stop();
+    void   CountDodOpen(Clock::duration a_latency);
+    void   CountDodReuse();
+    bool   HasStatistics() const;
+    void   SetStatistics(const LiberaColumnStats *a_stats, size_t a_cols);
 
 private:
     virtual void Initialize(mci::Node &a_node) = 0;
     virtual void UpdateSignal() = 0;
+    virtual void Suspend() {}
 
-    std::atomic<bool>   m_running;
-    std::thread         m_thread;
-    uint32_t            m_period;
+    static LiberaWorkerPool &GetPool();
+    void UpdateReservation();
+
+    std::atomic<uint32_t> m_period;
+    std::atomic<Clock::rep> m_lastRun; // time of last acquisition
     Tango::DevBoolean *&m_enabled;
     Tango::DevLong    *&m_length; // length of each column
-    bool                m_connected;
-    isig::AccessMode_e  m_mode;
+    std::atomic<bool>   m_connected;
+    std::atomic<bool>   m_stream; // reads block until data arrives
+    std::atomic<isig::AccessMode_e> m_mode;
+    std::atomic<uint64_t> m_dodOpens;
+    std::atomic<uint64_t> m_dodReuses;
+    std::atomic<uint64_t> m_dodOpenNs;
 
-    const std::string m_path;
+    const LiberaPaths::Entry *const m_path; // interned signal path
+    std::mutex         m_error_x;
+    std::string        m_error;  // reason of last connection loss
     mci::Node m_root;
 
+    /**
+     * Scalar attributes of one column statistics, allocated by the signal,
+     * and the latest statistics not applied to them yet.
+     */
+    struct StatAttr {
+        size_t column;
+        LiberaColumnStats value;
+        Tango::DevDouble *mean;
+        Tango::DevDouble *std;
+        Tango::DevDouble *min;
+        Tango::DevDouble *max;
+        Tango::DevDouble *p2p;
+    };
+    std::mutex            m_stats_x;
+    std::vector<StatAttr> m_stats;
+    std::atomic<bool>     m_hasStats;
+    bool                  m_statsFresh; // computed since last apply
+
+    LiberaLatency  m_latency[eLatencyCount];
+
     SignalCallback m_callback;
     void *m_callback_arg;
 };
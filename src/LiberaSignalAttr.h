@@ -8,7 +8,6 @@
 #ifndef LIBERA_SIGNAL_ATTR_H
 #define LIBERA_SIGNAL_ATTR_H
 
-#include <mutex>
 #include <functional>
 
 #include <mci/mci.h>
@@ -19,6 +18,10 @@
 #include <isig/data_on_demand_remote_source.h>
 
 #include "LiberaSignal.h"
+#include "LiberaTripleBuffer.h"
+#include "LiberaTranspose.h"
+#include "LiberaSlab.h"
+#include "LiberaHistory.h"
 
 /**
  * Type mapping template structure.
@@ -47,10 +50,13 @@ class LiberaSignalAttr : public LiberaSignal {
 public:
     typedef typename TangoToTraits<TangoType>::Type Traits;
     typedef typename isig::Array<Traits>            ClientBuffer;
+    typedef typename Traits::BaseType               BaseType;
     typedef typename isig::RemoteStream<Traits>     RStream;
     typedef isig::DataOnDemandRemoteSource<Traits>  RSource;
     typedef typename RStream::Client                StreamClient;
     typedef typename RSource::Client                DodClient;
+    typedef typename LiberaSlabPool<TangoType>::SlabPtr SlabPtr;
+    typedef typename LiberaHistory<ClientBuffer>::Entry HistoryEntry;
 
     /**
      * Implementation of signal class allocates memory for spectrum attributes.
@@ -62,7 +68,12 @@ public:
         Ts & ... ts)
       :  LiberaSignal(a_path, a_length, a_enabled, a_bufSize),
          m_offset(0),
-         m_updated(false)
+         m_decimation(eDecimationNone),
+         m_factor(1),
+         m_dodOpen(false),
+         m_dodMode(isig::eModeDodNow),
+         m_dodSize(0),
+         m_dodOffset(0)
     {
         Add(ts...);
         Alloc();
@@ -73,6 +84,7 @@ public:
         istd_FTRC();
         // Protect race with UpdateSignal call, stop update thread first.
         Stop();
+        CloseDod();
         Free();
     }
 
@@ -84,6 +96,7 @@ public:
         istd_FTRC();
         // No locking needed here since changing only user side buffers that
         // are updated on user request.
+        m_published.reset();
         Free();
         SetLength(a_length);
         Alloc();
@@ -94,7 +107,7 @@ public:
      */
     bool IsUpdated()
     {
-        return m_updated;
+        return m_data.IsFresh() || m_slabs.IsFresh();
     }
 
     /**
@@ -102,7 +115,81 @@ public:
      */
     void ClearUpdated()
     {
-        m_updated = false;
+        m_data.Take();
+        m_slabs.Take();
+    }
+
+    /**
+     * Decimate acquired data before it is published. Spectrum attributes
+     * then hold GetOutputLength samples per column, pointing to reduced
+     * slabs instead of the signal's own buffers. The full rate data is still
+     * available with GetFullRate.
+     */
+    virtual void SetDecimation(LiberaDecimation_e a_type, size_t a_factor)
+    {
+        if (a_type == eDecimationCic) {
+            a_factor = std::min(a_factor, c_cicMaxFactor);
+        }
+        std::lock_guard<std::mutex> l(m_decimation_x);
+        m_decimation = a_type;
+        m_factor = std::max<size_t>(a_factor, 1);
+    }
+
+    /**
+     * Number of samples per column published to spectrum attributes.
+     */
+    virtual size_t GetOutputLength()
+    {
+        LiberaDecimation_e type;
+        size_t factor;
+        GetDecimation(type, factor);
+        return LiberaDecimatedLength(type, factor, GetLength());
+    }
+
+    /**
+     * Copy the latest full rate data to a_dst column arrays of GetLength
+     * samples. Must not be called concurrently with GetData.
+     */
+    bool GetFullRate(TangoType *const *a_dst)
+    {
+        m_data.Take();
+        std::shared_ptr<ClientBuffer> &buf(m_data.Front());
+        if (!buf || buf->GetLength() != GetLength()) {
+            return false;
+        }
+        Transpose(*buf, a_dst);
+        return true;
+    }
+
+    /**
+     * Keep the last a_capacity stream buffers, zero disables the history.
+     */
+    virtual void SetHistory(size_t a_capacity)
+    {
+        m_history.SetCapacity(a_capacity);
+    }
+
+    virtual LiberaHistoryStats GetHistoryStats()
+    {
+        return m_history.GetStats();
+    }
+
+    /**
+     * Fetch up to a_count latest stream buffers, oldest first.
+     */
+    size_t GetLast(size_t a_count, std::vector<HistoryEntry> &a_out)
+    {
+        return m_history.GetLast(a_count, a_out);
+    }
+
+    /**
+     * Fetch stream buffers acquired after sequence number a_seq, oldest
+     * first. The number of buffers already dropped is returned in a_missed.
+     */
+    size_t GetSince(uint64_t a_seq, std::vector<HistoryEntry> &a_out,
+        uint64_t &a_missed)
+    {
+        return m_history.GetSince(a_seq, a_out, a_missed);
     }
 
     virtual void SetOffset(int32_t a_offset)
@@ -112,33 +199,149 @@ public:
 
 protected:
     /**
-     * Method for copying buffer data.
+     * Method for copying buffer data. Takes the latest acquired buffer
+     * without blocking the acquisition, must not be called concurrently.
      */
     virtual void GetData()
     {
         istd_FTRC();
+        LiberaLatency::Scope t(GetLatency(eLatencyGetData));
+        ApplyStatistics();
+        if (IsDecimated()) {
+            // full rate data is kept for GetFullRate
+            GetSlab();
+            return;
+        }
+        m_slabs.Take(); // drop data decimated before the mode change
+        ReleaseSlab();
         // Skip data copy if not updated.
-        if (!m_updated) {
+        if (!m_data.Take()) {
             return;
         }
-        std::lock_guard<std::mutex> l(m_data_x);
-        if (m_buf->GetLength() != GetLength()) {
+        ClientBuffer &buf(*m_data.Front());
+        if (buf.GetLength() != GetLength()) {
+            // Acquisition adjusts its buffer on next read.
             istd_TRC(istd::eTrcMed, "Buffer size changed while reading signal."
-                << " Was: " << m_buf->GetLength() << ", is: " << GetLength());
-            m_buf->Resize(GetLength());
-            // Invalidate buffer so that next acquisition can adjust it.
-            m_updated = false;
+                << " Was: " << buf.GetLength() << ", is: " << GetLength());
             return;
         }
+        Transpose(buf, m_own.data());
+        istd_TRC(istd::eTrcHigh, "Data copied, buffer size: "
+            << buf.GetLength());
+    }
+
+    /**
+     * Point spectrum attributes to the columns of the latest slab.
+     */
+    void GetSlab()
+    {
+        if (!m_slabs.Take()) {
+            return;
+        }
+        SlabPtr &slab(m_slabs.Front());
+        if (!slab || slab->GetLength() != GetOutputLength()) {
+            istd_TRC(istd::eTrcMed, "Buffer size changed while reading signal."
+                << " Is: " << GetOutputLength());
+            return;
+        }
+        m_published = slab;
         for (size_t i(0); i != m_columns.size(); ++i) {
-            TangoType *&attr = m_columns[i].get();
-            for (size_t j(0); j < GetLength(); ++j) {
-                attr[j] = (*m_buf)[j][i];
+            m_columns[i].get() = slab->Column(i);
+        }
+        istd_TRC(istd::eTrcHigh, "Data published, buffer size: "
+            << slab->GetLength());
+    }
+
+    /**
+     * Point spectrum attributes back to own buffers after decimation.
+     */
+    void ReleaseSlab()
+    {
+        if (!m_published) {
+            return;
+        }
+        m_published.reset();
+        for (size_t i(0); i != m_columns.size(); ++i) {
+            m_columns[i].get() = m_own[i];
+        }
+    }
+
+    /**
+     * Convert atom components to column arrays with the vectorized
+     * transpose kernel if atoms are stored contiguously, element by element
+     * otherwise.
+     */
+    void Transpose(ClientBuffer &a_buf, TangoType *const *a_dst)
+    {
+        const size_t rows(a_buf.GetLength());
+        const size_t cols(m_columns.size());
+        if (rows == 0 || cols == 0) {
+            return;
+        }
+        size_t stride;
+        if (IsContiguous(a_buf, stride)) {
+            LiberaTranspose(&a_buf[0][0], stride, rows, a_dst, cols);
+            return;
+        }
+        for (size_t i(0); i != cols; ++i) {
+            TangoType *attr = a_dst[i];
+            for (size_t j(0); j < rows; ++j) {
+                attr[j] = a_buf[j][i];
             }
         }
-        istd_TRC(istd::eTrcHigh, "Data copied, buffer size: "
-            << m_buf->GetLength());
-        m_updated = false;
+    }
+
+    /**
+     * Check if atoms are stored one after another with equal distance,
+     * returned in a_stride.
+     */
+    bool IsContiguous(ClientBuffer &a_buf, size_t &a_stride)
+    {
+        const size_t rows(a_buf.GetLength());
+        const size_t cols(m_columns.size());
+        const auto *base(&a_buf[0][0]);
+        a_stride = rows > 1 ? &a_buf[1][0] - base : cols;
+        return a_stride >= cols
+            && &a_buf[rows - 1][0] == base + (rows - 1) * a_stride;
+    }
+
+    /**
+     * Atoms of the buffer stored one after another a_stride components
+     * apart. Atoms not stored that way are first packed into a scratch
+     * buffer, used by the worker only.
+     */
+    const BaseType *GetAtoms(ClientBuffer &a_buf, size_t &a_stride)
+    {
+        if (IsContiguous(a_buf, a_stride)) {
+            return &a_buf[0][0];
+        }
+        const size_t rows(a_buf.GetLength());
+        const size_t cols(m_columns.size());
+        m_packed.resize(rows * cols);
+        for (size_t j(0); j < rows; ++j) {
+            std::copy(a_buf[j], a_buf[j] + cols, &m_packed[j * cols]);
+        }
+        a_stride = cols;
+        return &m_packed[0];
+    }
+
+    /**
+     * Compute column statistics of acquired data for the statistics
+     * attributes. Done in one pass over the raw atoms, before the buffer is
+     * handed over to the reader.
+     */
+    void UpdateStatistics(ClientBuffer &a_buf)
+    {
+        const size_t rows(a_buf.GetLength());
+        const size_t cols(m_columns.size());
+        if (rows == 0 || cols == 0) {
+            return;
+        }
+        size_t stride;
+        const BaseType *atoms(GetAtoms(a_buf, stride));
+        m_colStats.resize(cols);
+        LiberaColumnStatistics(atoms, stride, rows, cols, &m_colStats[0]);
+        SetStatistics(&m_colStats[0], cols);
     }
 
     /**
@@ -177,11 +380,12 @@ private:
     void Alloc()
     {
         istd_FTRC();
-        for (auto i = m_columns.begin(); i != m_columns.end(); ++i) {
-            TangoType *&attr(*i);
+        m_own.resize(m_columns.size());
+        for (size_t i(0); i != m_columns.size(); ++i) {
             size_t len(GetLength());
-            attr = new TangoType[len];
-            std::fill(attr, attr + len, TangoType(0));
+            m_own[i] = new TangoType[len];
+            std::fill(m_own[i], m_own[i] + len, TangoType(0));
+            m_columns[i].get() = m_own[i];
         }
         istd_TRC(istd::eTrcDetail, "New size: " << GetLength());
     }
@@ -192,9 +396,8 @@ private:
     void Free()
     {
         istd_FTRC();
-        for (auto i = m_columns.begin(); i != m_columns.end(); ++i) {
-            TangoType *&attr(*i);
-            delete [] attr;
+        for (auto i = m_own.begin(); i != m_own.end(); ++i) {
+            delete [] *i;
         }
     }
 
@@ -207,13 +410,14 @@ private:
         istd_FTRC();
 
         m_signal = mci::CreateRemoteSignal(a_node);
+        SetStream(m_signal->AccessType() == isig::eAccessStream);
         if (m_signal->AccessType() == isig::eAccessStream) {
             m_stream = std::dynamic_pointer_cast<RStream>(m_signal);
             if (m_streamClient && m_streamClient->IsOpen()) {
                 m_streamClient->Close();
             }
             m_streamClient = std::make_shared<StreamClient>(m_stream.get(), "stream_client");
-            m_buf =  std::make_shared<ClientBuffer>(m_streamClient->CreateBuffer(GetLength()));
+            CreateBuffers(m_streamClient->CreateBuffer(GetLength()));
             if (m_streamClient->Open() != isig::eSuccess) {
                 throw istd::Exception("Failed to open stream!");
             }
@@ -221,11 +425,9 @@ private:
         else if (m_signal->AccessType() == isig::eAccessDataOnDemand) {
 
             m_dod = std::dynamic_pointer_cast<RSource>(m_signal);
-            if (m_dodClient && m_dodClient->IsOpen()) {
-                m_dodClient->Close();
-            }
+            CloseDod();
             m_dodClient = std::make_shared<DodClient>(m_dod, "dod_client", m_dod->GetTraits());
-            m_buf = std::make_shared<ClientBuffer>(m_dodClient->CreateBuffer(GetLength()));
+            CreateBuffers(m_dodClient->CreateBuffer(GetLength()));
 
             // No open here, since the dod client is opened just before read
         }
@@ -234,16 +436,109 @@ private:
         }
     }
 
+    /**
+     * Create acquisition buffers for the triple buffer handoff.
+     */
+    void CreateBuffers(const ClientBuffer &a_buf)
+    {
+        m_data.Reset(
+            std::make_shared<ClientBuffer>(a_buf),
+            std::make_shared<ClientBuffer>(a_buf),
+            std::make_shared<ClientBuffer>(a_buf));
+    }
+
+    /**
+     * Buffer for next acquisition, adjusted to current buffer size. A buffer
+     * still kept in the history is replaced with a spare one.
+     */
+    ClientBuffer &GetBackBuffer()
+    {
+        std::shared_ptr<ClientBuffer> &back(m_data.Back());
+        if (!back.unique()) {
+            std::shared_ptr<ClientBuffer> spare(m_history.Spare());
+            back = spare ? spare : std::make_shared<ClientBuffer>(*back);
+        }
+        ClientBuffer &buf(*back);
+        if (buf.GetLength() != GetLength()) {
+            buf.Resize(GetLength());
+        }
+        return buf;
+    }
+
+    /**
+     * Publish acquired buffer to the reader. Decimated data is converted
+     * into a slab not referenced by the reader and that is published as
+     * well.
+     */
+    void PublishBuffer()
+    {
+        if (HasStatistics()) {
+            UpdateStatistics(*m_data.Back());
+        }
+        bool dropped(false);
+        LiberaDecimation_e type;
+        size_t factor;
+        GetDecimation(type, factor);
+        if (LiberaIsDecimated(type, factor)) {
+            Decimate(type, factor);
+            dropped = m_slabs.Publish();
+            m_data.Publish();
+        }
+        else {
+            dropped = m_data.Publish();
+        }
+        if (dropped) {
+            istd_TRC(istd::eTrcHigh, "Previous data not copied, replaced.");
+        }
+    }
+
+    /**
+     * Decimate acquired buffer into a slab not referenced by the reader.
+     */
+    void Decimate(LiberaDecimation_e a_type, size_t a_factor)
+    {
+        ClientBuffer &buf(*m_data.Back());
+        const size_t rows(buf.GetLength());
+        const size_t cols(m_columns.size());
+        SlabPtr &slab(m_slabs.Back());
+        m_slabPool.Rotate(slab, cols,
+            LiberaDecimatedLength(a_type, a_factor, rows));
+        if (slab->GetLength() == 0 || cols == 0) {
+            return;
+        }
+        size_t stride;
+        const BaseType *atoms(GetAtoms(buf, stride));
+        LiberaDecimate(a_type, a_factor, atoms, stride, rows,
+            slab->Columns(), cols);
+    }
+
+    void GetDecimation(LiberaDecimation_e &a_type, size_t &a_factor)
+    {
+        std::lock_guard<std::mutex> l(m_decimation_x);
+        a_type = m_decimation;
+        a_factor = m_factor;
+    }
+
+    bool IsDecimated()
+    {
+        LiberaDecimation_e type;
+        size_t factor;
+        GetDecimation(type, factor);
+        return LiberaIsDecimated(type, factor);
+    }
+
     /**
      * Update internal data buffer using stream client.
      */
     void UpdateStream()
     {
-        std::lock_guard<std::mutex> l(m_data_x);
-        if (m_streamClient->Read(*m_buf) == isig::eSuccess) {
-            m_updated = true;
+        LiberaLatency::Scope t(GetLatency(eLatencyStream));
+        ClientBuffer &buf(GetBackBuffer());
+        if (m_streamClient->Read(buf) == isig::eSuccess) {
+            m_history.Push(m_data.Back(), buf.GetLength());
+            PublishBuffer();
             istd_TRC(istd::eTrcMed, "Stream data read, buffer size: "
-                << m_buf->GetLength());
+                << buf.GetLength());
         }
         else {
             // disable signal
@@ -252,42 +547,76 @@ private:
     }
 
     /**
-     * Update internal data buffer using dod client.
+     * Open the dod client unless it is already open with the same mode and
+     * read size. Reopening costs a round trip to the signal server on every
+     * trigger, so the session is kept between reads.
      */
-    void UpdateDod()
+    void OpenDod(size_t a_size, size_t a_offset)
     {
-        // skip read if not copied since last update
-        if (!m_updated) {
+        const isig::AccessMode_e mode(GetMode());
+        if (m_dodOpen && mode == m_dodMode && a_size == m_dodSize
+            && a_offset == m_dodOffset) {
+            CountDodReuse();
+            return;
+        }
+        const Clock::time_point start(Clock::now());
+        CloseDod();
+        if (m_dodClient->Open(mode, a_size, a_offset) != isig::eSuccess) {
+            istd_TRC(istd::eTrcLow, "Error opening dod in mode: " << mode);
+            throw istd::Exception("Failed to open dod!");
+        }
+        m_dodOpen = true;
+        m_dodMode = mode;
+        m_dodSize = a_size;
+        m_dodOffset = a_offset;
+        CountDodOpen(Clock::now() - start);
+        istd_TRC(istd::eTrcMed, "Dod opened in mode: " << mode
+            << ", read size: " << a_size);
+    }
 
-            size_t readSize(GetLength()); // number of atoms to be read on event
-            size_t offset(0); // TODO: use ExternalTriggerDelay here?
-            isig::SignalMeta signal_meta;
+    void CloseDod()
+    {
+        if (m_dodClient && m_dodClient->IsOpen()) {
+            m_dodClient->Close();
+        }
+        m_dodOpen = false;
+    }
 
-            std::lock_guard<std::mutex> l(m_data_x);
-            if (m_dodClient->Open(GetMode(), readSize, offset) != isig::eSuccess) {
-                istd_TRC(istd::eTrcLow, "Error opening dod in mode: " << GetMode());
-                throw istd::Exception("Failed to open dod!");
-            }
+    /**
+     * Acquisition stopped, release the dod session.
+     */
+    virtual void Suspend()
+    {
+        CloseDod();
+    }
 
-            // Can be optimized using MetaBufferPtr if necessary.
-            auto ret = m_dodClient->Read(*m_buf, signal_meta, GetOffset());
-            if ( ret == isig::eSuccess) {
-                m_updated = true;
-                istd_TRC(istd::eTrcMed, "Dod data read, buffer size: "
-                    << m_buf->GetLength());
-            }
-            else {
-                // disable signal
-                istd_TRC(istd::eTrcLow, "Error reading dod in mode: " << GetMode());
-                istd_EXCEPTION("Failed to read dod!" << ret);
-            }
-            m_dodClient->Close();
+    /**
+     * Update internal data buffer using dod client. Data not copied since
+     * last update is replaced, so no trigger is skipped because of a slow
+     * reader.
+     */
+    void UpdateDod()
+    {
+        LiberaLatency::Scope t(GetLatency(eLatencyDod));
+        size_t readSize(GetLength()); // number of atoms to be read on event
+        size_t offset(0); // TODO: use ExternalTriggerDelay here?
+        isig::SignalMeta signal_meta;
+
+        ClientBuffer &buf(GetBackBuffer());
+        OpenDod(readSize, offset);
+
+        // Can be optimized using MetaBufferPtr if necessary.
+        auto ret = m_dodClient->Read(buf, signal_meta, GetOffset());
+        if ( ret == isig::eSuccess) {
+            PublishBuffer();
+            istd_TRC(istd::eTrcMed, "Dod data read, buffer size: "
+                << buf.GetLength());
         }
         else {
-            if (GetMode() != isig::eModeDodNow) {
-                // avoid busy loop when not reading
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            }
+            // disable signal
+            istd_TRC(istd::eTrcLow, "Error reading dod in mode: " << GetMode());
+            CloseDod();
+            istd_EXCEPTION("Failed to read dod!" << ret);
         }
     }
 
@@ -311,10 +640,26 @@ private:
     std::shared_ptr<StreamClient> m_streamClient;
     std::shared_ptr<RSource>      m_dod;
     std::shared_ptr<DodClient>    m_dodClient;
+    // parameters of the open dod session, used by the worker only
+    bool                          m_dodOpen;
+    isig::AccessMode_e            m_dodMode;
+    size_t                        m_dodSize;
+    size_t                        m_dodOffset;
     std::vector<std::reference_wrapper<TangoType *> > m_columns;
-    std::atomic<bool>             m_updated;
-    std::mutex                    m_data_x; // protects m_buf access
-    std::shared_ptr<ClientBuffer> m_buf;
+    std::vector<TangoType *>      m_own; // column buffers owned by signal
+    std::mutex                    m_decimation_x;
+    LiberaDecimation_e            m_decimation;
+    size_t                        m_factor;
+    // acquired buffers, written by the worker and read by GetData
+    LiberaTripleBuffer<std::shared_ptr<ClientBuffer> > m_data;
+    // decimated buffers, the acquisition side keeps slabs still in use in
+    // the pool
+    LiberaTripleBuffer<SlabPtr>   m_slabs;
+    LiberaSlabPool<TangoType>     m_slabPool;
+    SlabPtr                       m_published; // slab attributes point to
+    LiberaHistory<ClientBuffer>   m_history;
+    std::vector<LiberaColumnStats> m_colStats; // used by the worker only
+    std::vector<BaseType>         m_packed;   // used by the worker only
 };
 
 #endif //LIBERA_SIGNAL_ATTR_H
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_SLAB_H
+#define LIBERA_SLAB_H
+
+#include <vector>
+#include <memory>
+
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ > 4)
+    #include <atomic>
+#else
+    #include <cstdatomic>
+#endif
+
+/*******************************************************************************
+ * Converted signal data, one contiguous column per atom component.
+ * Slabs are shared between the acquisition and the attributes that publish
+ * their columns, a slab is refilled only when nobody else refers to it.
+ */
+template <typename T>
+class LiberaSlab {
+public:
+    LiberaSlab(size_t a_columns, size_t a_length)
+      : m_length(a_length),
+        m_data(a_columns * a_length),
+        m_columns(a_columns)
+    {
+        for (size_t i(0); i != a_columns; ++i) {
+            m_columns[i] = m_data.data() + i * a_length;
+        }
+    }
+
+    size_t GetLength() const { return m_length; }
+    size_t GetColumns() const { return m_columns.size(); }
+
+    T *Column(size_t a_index) { return m_columns[a_index]; }
+
+    /**
+     * Column pointers, as expected by LiberaTranspose.
+     */
+    T *const *Columns() { return &m_columns[0]; }
+
+private:
+    LiberaSlab(const LiberaSlab &);
+    LiberaSlab &operator=(const LiberaSlab &);
+
+    size_t           m_length;
+    std::vector<T>   m_data;
+    std::vector<T *> m_columns;
+};
+
+/*******************************************************************************
+ * Slabs retired by the acquisition while still referenced elsewhere.
+ * Only used by the acquisition side, a slab is handed out again once its
+ * other references are gone.
+ */
+template <typename T>
+class LiberaSlabPool {
+public:
+    typedef std::shared_ptr<LiberaSlab<T> > SlabPtr;
+
+    /**
+     * Replace a_slab with a slab of requested size that is not referenced
+     * anywhere else. The slab passed in is kept unless it was unique.
+     */
+    void Rotate(SlabPtr &a_slab, size_t a_columns, size_t a_length)
+    {
+        if (Fits(a_slab, a_columns, a_length)) {
+            return;
+        }
+        if (a_slab && !a_slab.unique()) {
+            m_retired.push_back(a_slab);
+        }
+        a_slab.reset();
+        for (auto i = m_retired.begin(); i != m_retired.end(); ) {
+            if (!i->unique()) {
+                ++i;
+            }
+            else if (!a_slab && Fits(*i, a_columns, a_length)) {
+                a_slab = *i;
+                i = m_retired.erase(i);
+            }
+            else {
+                // released, but of wrong size or not needed
+                i = m_retired.erase(i);
+            }
+        }
+        if (!a_slab) {
+            a_slab = std::make_shared<LiberaSlab<T> >(a_columns, a_length);
+        }
+    }
+
+    void Clear()
+    {
+        m_retired.clear();
+    }
+
+private:
+    /**
+     * Usable for refill: right size and no other owner. The fence orders
+     * the refill after the last access of the released owner.
+     */
+    static bool Fits(const SlabPtr &a_slab, size_t a_columns, size_t a_length)
+    {
+        if (!a_slab || !a_slab.unique()
+            || a_slab->GetColumns() != a_columns
+            || a_slab->GetLength() != a_length) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    std::vector<SlabPtr> m_retired;
+};
+
+#endif //LIBERA_SLAB_H
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_STATISTICS_H
+#define LIBERA_STATISTICS_H
+
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+/**
+ * Statistics of one signal column.
+ */
+struct LiberaColumnStats {
+    double mean;
+    double std;
+    double min;
+    double max;
+    double p2p; // peak to peak
+};
+
+/**
+ * Compute statistics of a_cols columns of a_rows atoms, stored one after
+ * another a_stride components apart, in a single pass over the buffer.
+ * Sums are accumulated relative to the first atom, which keeps the variance
+ * accurate for signals with a large offset.
+ */
+template <typename S>
+void LiberaColumnStatistics(const S *a_src, size_t a_stride, size_t a_rows,
+    size_t a_cols, LiberaColumnStats *a_out)
+{
+    const size_t chunk(16); // columns accumulated at once
+    for (size_t c0(0); c0 < a_cols; c0 += chunk) {
+        const size_t n(std::min(chunk, a_cols - c0));
+        double shift[chunk], sum[chunk], sumsq[chunk];
+        S lo[chunk], hi[chunk];
+        for (size_t c(0); c < n; ++c) {
+            const S v(a_rows ? a_src[c0 + c] : S(0));
+            shift[c] = v;
+            sum[c] = 0;
+            sumsq[c] = 0;
+            lo[c] = v;
+            hi[c] = v;
+        }
+        const S *row(a_src + c0);
+        for (size_t r(0); r < a_rows; ++r, row += a_stride) {
+            for (size_t c(0); c < n; ++c) {
+                const S v(row[c]);
+                const double d(double(v) - shift[c]);
+                sum[c] += d;
+                sumsq[c] += d * d;
+                lo[c] = std::min(lo[c], v);
+                hi[c] = std::max(hi[c], v);
+            }
+        }
+        for (size_t c(0); c < n; ++c) {
+            LiberaColumnStats &s(a_out[c0 + c]);
+            const double mean(a_rows ? sum[c] / a_rows : 0);
+            const double var(a_rows ? sumsq[c] / a_rows - mean * mean : 0);
+            s.mean = shift[c] + mean;
+            s.std = std::sqrt(std::max(var, 0.0));
+            s.min = lo[c];
+            s.max = hi[c];
+            s.p2p = s.max - s.min;
+        }
+    }
+}
+
+#endif //LIBERA_STATISTICS_H
@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include "LiberaTranspose.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+    // per function target attributes with intrinsics need gcc 4.9
+    #define LIBERA_TRANSPOSE_X86
+    #include <immintrin.h>
+#endif
+
+namespace {
+
+const size_t c_block = 256; // rows per block, source block stays in L1
+
+/**
+ * Scalar part for columns [a_c0, a_c1) of the row block.
+ */
+template <typename S, typename D>
+inline void ScalarCols(const S *a_src, size_t a_stride, size_t a_r0, size_t a_r1,
+    D *const *a_dst, size_t a_c0, size_t a_c1)
+{
+    for (size_t c(a_c0); c < a_c1; ++c) {
+        D *d(a_dst[c]);
+        const S *s(a_src + a_r0 * a_stride + c);
+        for (size_t r(a_r0); r < a_r1; ++r, s += a_stride) {
+            d[r] = *s;
+        }
+    }
+}
+
+/**
+ * Scalar part for rows [a_r0, a_r1) of columns [a_c0, a_c1).
+ */
+template <typename S, typename D>
+inline void ScalarRows(const S *a_src, size_t a_stride, size_t a_r0, size_t a_r1,
+    D *const *a_dst, size_t a_c0, size_t a_c1)
+{
+    for (size_t r(a_r0); r < a_r1; ++r) {
+        const S *s(a_src + r * a_stride);
+        for (size_t c(a_c0); c < a_c1; ++c) {
+            a_dst[c][r] = s[c];
+        }
+    }
+}
+
+typedef void (*Int32Kernel)(const int32_t *, size_t, size_t, double *const *, size_t);
+typedef void (*Int16Kernel)(const int16_t *, size_t, size_t, int16_t *const *, size_t);
+
+void Int32Scalar(const int32_t *a_src, size_t a_stride, size_t a_rows,
+    double *const *a_dst, size_t a_cols)
+{
+    LiberaTranspose<int32_t, double>(a_src, a_stride, a_rows, a_dst, a_cols);
+}
+
+void Int16Scalar(const int16_t *a_src, size_t a_stride, size_t a_rows,
+    int16_t *const *a_dst, size_t a_cols)
+{
+    LiberaTranspose<int16_t, int16_t>(a_src, a_stride, a_rows, a_dst, a_cols);
+}
+
+#ifdef LIBERA_TRANSPOSE_X86
+
+/**
+ * Convert four int32 to double and store them.
+ */
+__attribute__((target("sse2")))
+inline void Store4(double *a_dst, __m128i a_val)
+{
+    _mm_storeu_pd(a_dst, _mm_cvtepi32_pd(a_val));
+    _mm_storeu_pd(a_dst + 2, _mm_cvtepi32_pd(_mm_shuffle_epi32(a_val, _MM_SHUFFLE(1, 0, 3, 2))));
+}
+
+/**
+ * Columns in groups of four, rows in 4x4 tiles transposed in registers.
+ * Returns the first column not processed.
+ */
+__attribute__((target("sse2")))
+size_t Int32Sse2Cols(const int32_t *a_src, size_t a_stride, size_t a_r0, size_t a_r1,
+    double *const *a_dst, size_t a_c0, size_t a_cols)
+{
+    size_t c(a_c0);
+    for (; c + 4 <= a_cols; c += 4) {
+        size_t r(a_r0);
+        for (; r + 4 <= a_r1; r += 4) {
+            const int32_t *s(a_src + r * a_stride + c);
+            const __m128i x0(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s)));
+            const __m128i x1(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + a_stride)));
+            const __m128i x2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 2 * a_stride)));
+            const __m128i x3(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 3 * a_stride)));
+            const __m128i t0(_mm_unpacklo_epi32(x0, x1));
+            const __m128i t1(_mm_unpacklo_epi32(x2, x3));
+            const __m128i t2(_mm_unpackhi_epi32(x0, x1));
+            const __m128i t3(_mm_unpackhi_epi32(x2, x3));
+            Store4(a_dst[c] + r,     _mm_unpacklo_epi64(t0, t1));
+            Store4(a_dst[c + 1] + r, _mm_unpackhi_epi64(t0, t1));
+            Store4(a_dst[c + 2] + r, _mm_unpacklo_epi64(t2, t3));
+            Store4(a_dst[c + 3] + r, _mm_unpackhi_epi64(t2, t3));
+        }
+        ScalarRows(a_src, a_stride, r, a_r1, a_dst, c, c + 4);
+    }
+    return c;
+}
+
+__attribute__((target("sse2")))
+void Int32Sse2(const int32_t *a_src, size_t a_stride, size_t a_rows,
+    double *const *a_dst, size_t a_cols)
+{
+    for (size_t r0(0); r0 < a_rows; r0 += c_block) {
+        const size_t r1(std::min(a_rows, r0 + c_block));
+        const size_t c(Int32Sse2Cols(a_src, a_stride, r0, r1, a_dst, 0, a_cols));
+        ScalarCols(a_src, a_stride, r0, r1, a_dst, c, a_cols);
+    }
+}
+
+/**
+ * Convert four int32 to double and store them with one 256 bit store.
+ */
+__attribute__((target("avx2")))
+inline void Store4Avx(double *a_dst, __m128i a_val)
+{
+    _mm256_storeu_pd(a_dst, _mm256_cvtepi32_pd(a_val));
+}
+
+/**
+ * Columns in groups of four, rows in 4x4 tiles transposed in registers.
+ * Wider tiles write too many column streams at once and are not faster.
+ */
+__attribute__((target("avx2")))
+void Int32Avx2(const int32_t *a_src, size_t a_stride, size_t a_rows,
+    double *const *a_dst, size_t a_cols)
+{
+    for (size_t r0(0); r0 < a_rows; r0 += c_block) {
+        const size_t r1(std::min(a_rows, r0 + c_block));
+        size_t c(0);
+        for (; c + 4 <= a_cols; c += 4) {
+            size_t r(r0);
+            for (; r + 4 <= r1; r += 4) {
+                const int32_t *s(a_src + r * a_stride + c);
+                const __m128i x0(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s)));
+                const __m128i x1(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + a_stride)));
+                const __m128i x2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 2 * a_stride)));
+                const __m128i x3(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 3 * a_stride)));
+                const __m128i t0(_mm_unpacklo_epi32(x0, x1));
+                const __m128i t1(_mm_unpacklo_epi32(x2, x3));
+                const __m128i t2(_mm_unpackhi_epi32(x0, x1));
+                const __m128i t3(_mm_unpackhi_epi32(x2, x3));
+                Store4Avx(a_dst[c] + r,     _mm_unpacklo_epi64(t0, t1));
+                Store4Avx(a_dst[c + 1] + r, _mm_unpackhi_epi64(t0, t1));
+                Store4Avx(a_dst[c + 2] + r, _mm_unpacklo_epi64(t2, t3));
+                Store4Avx(a_dst[c + 3] + r, _mm_unpackhi_epi64(t2, t3));
+            }
+            ScalarRows(a_src, a_stride, r, r1, a_dst, c, c + 4);
+        }
+        ScalarCols(a_src, a_stride, r0, r1, a_dst, c, a_cols);
+    }
+}
+
+/**
+ * Columns in groups of four, rows in 4x4 tiles of 64 bit loads.
+ */
+__attribute__((target("sse2")))
+void Int16Sse2(const int16_t *a_src, size_t a_stride, size_t a_rows,
+    int16_t *const *a_dst, size_t a_cols)
+{
+    for (size_t r0(0); r0 < a_rows; r0 += c_block) {
+        const size_t r1(std::min(a_rows, r0 + c_block));
+        size_t c(0);
+        for (; c + 4 <= a_cols; c += 4) {
+            size_t r(r0);
+            for (; r + 4 <= r1; r += 4) {
+                const int16_t *s(a_src + r * a_stride + c);
+                const __m128i x0(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(s)));
+                const __m128i x1(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + a_stride)));
+                const __m128i x2(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + 2 * a_stride)));
+                const __m128i x3(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + 3 * a_stride)));
+                const __m128i t0(_mm_unpacklo_epi16(x0, x1));
+                const __m128i t1(_mm_unpacklo_epi16(x2, x3));
+                const __m128i c01(_mm_unpacklo_epi32(t0, t1));
+                const __m128i c23(_mm_unpackhi_epi32(t0, t1));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(a_dst[c] + r), c01);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(a_dst[c + 1] + r), _mm_unpackhi_epi64(c01, c01));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(a_dst[c + 2] + r), c23);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(a_dst[c + 3] + r), _mm_unpackhi_epi64(c23, c23));
+            }
+            ScalarRows(a_src, a_stride, r, r1, a_dst, c, c + 4);
+        }
+        ScalarCols(a_src, a_stride, r0, r1, a_dst, c, a_cols);
+    }
+}
+
+/**
+ * Best supported kernel, checked once.
+ */
+LiberaKernel_e Select(LiberaKernel_e a_kernel)
+{
+    static const LiberaKernel_e best(
+        LiberaKernelSupported(eKernelAvx2) ? eKernelAvx2 :
+        LiberaKernelSupported(eKernelSse2) ? eKernelSse2 : eKernelScalar);
+    if (a_kernel == eKernelAuto || !LiberaKernelSupported(a_kernel)) {
+        return best;
+    }
+    return a_kernel;
+}
+
+#endif // LIBERA_TRANSPOSE_X86
+
+} // namespace
+
+bool LiberaKernelSupported(LiberaKernel_e a_kernel)
+{
+    switch (a_kernel) {
+    case eKernelAuto:
+    case eKernelScalar:
+        return true;
+#ifdef LIBERA_TRANSPOSE_X86
+    case eKernelSse2:
+        return __builtin_cpu_supports("sse2");
+    case eKernelAvx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+const char *LiberaKernelName(LiberaKernel_e a_kernel)
+{
+    switch (a_kernel) {
+    case eKernelAuto:   return "auto";
+    case eKernelScalar: return "scalar";
+    case eKernelSse2:   return "sse2";
+    case eKernelAvx2:   return "avx2";
+    }
+    return "unknown";
+}
+
+void LiberaTranspose(const int32_t *a_src, size_t a_stride, size_t a_rows,
+    double *const *a_dst, size_t a_cols, LiberaKernel_e a_kernel)
+{
+    Int32Kernel k(Int32Scalar);
+#ifdef LIBERA_TRANSPOSE_X86
+    switch (Select(a_kernel)) {
+    case eKernelAvx2: k = Int32Avx2; break;
+    case eKernelSse2: k = Int32Sse2; break;
+    default: break;
+    }
+#else
+    (void)a_kernel;
+#endif
+    k(a_src, a_stride, a_rows, a_dst, a_cols);
+}
+
+void LiberaTranspose(const int16_t *a_src, size_t a_stride, size_t a_rows,
+    int16_t *const *a_dst, size_t a_cols, LiberaKernel_e a_kernel)
+{
+    Int16Kernel k(Int16Scalar);
+#ifdef LIBERA_TRANSPOSE_X86
+    switch (Select(a_kernel)) {
+    case eKernelAvx2: // no wider int16 kernel
+    case eKernelSse2: k = Int16Sse2; break;
+    default: break;
+    }
+#else
+    (void)a_kernel;
+#endif
+    k(a_src, a_stride, a_rows, a_dst, a_cols);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_TRANSPOSE_H
+#define LIBERA_TRANSPOSE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+/**
+ * Transpose kernel implementations, selected at runtime with eKernelAuto.
+ */
+enum LiberaKernel_e {
+    eKernelAuto,
+    eKernelScalar,
+    eKernelSse2,
+    eKernelAvx2
+};
+
+bool LiberaKernelSupported(LiberaKernel_e a_kernel);
+const char *LiberaKernelName(LiberaKernel_e a_kernel);
+
+/**
+ * Deinterleave a_rows atoms of a_cols components into a_cols column arrays.
+ * Atoms are stored one after another, a_stride components apart.
+ * Vectorized kernels exist for the signal buffer types, int32 to double
+ * conversion and int16 copy.
+ */
+void LiberaTranspose(const int32_t *a_src, size_t a_stride, size_t a_rows,
+    double *const *a_dst, size_t a_cols, LiberaKernel_e a_kernel = eKernelAuto);
+void LiberaTranspose(const int16_t *a_src, size_t a_stride, size_t a_rows,
+    int16_t *const *a_dst, size_t a_cols, LiberaKernel_e a_kernel = eKernelAuto);
+
+/**
+ * Portable kernel for any other type combination. Rows are processed in
+ * blocks small enough for the source to stay in the first level cache while
+ * each column is written sequentially.
+ */
+template <typename S, typename D>
+void LiberaTranspose(const S *a_src, size_t a_stride, size_t a_rows,
+    D *const *a_dst, size_t a_cols, LiberaKernel_e = eKernelAuto)
+{
+    const size_t block(256);
+    for (size_t r0(0); r0 < a_rows; r0 += block) {
+        const size_t r1(std::min(a_rows, r0 + block));
+        for (size_t c(0); c < a_cols; ++c) {
+            D *d(a_dst[c]);
+            const S *s(a_src + r0 * a_stride + c);
+            for (size_t r(r0); r < r1; ++r, s += a_stride) {
+                d[r] = *s;
+            }
+        }
+    }
+}
+
+#endif //LIBERA_TRANSPOSE_H
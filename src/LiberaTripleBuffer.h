@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_TRIPLE_BUFFER_H
+#define LIBERA_TRIPLE_BUFFER_H
+
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ > 4)
+    #include <atomic>
+#else
+    #include <cstdatomic>
+#endif
+
+/*******************************************************************************
+ * Lock-free handoff of the latest data between one writer and one reader.
+ * The writer always fills the back slot and publishes it, the reader takes
+ * the latest published slot as its front. Neither side waits for the other
+ * and the slot being read is never overwritten.
+ */
+template <typename T>
+class LiberaTripleBuffer {
+public:
+    LiberaTripleBuffer()
+      : m_back(0),
+        m_middle(1),
+        m_front(2)
+    {
+    }
+
+    /**
+     * Set all slots to given value, must not be called while the writer or
+     * the reader is active.
+     */
+    void Reset(const T &a_back, const T &a_middle, const T &a_front)
+    {
+        m_back = 0;
+        m_middle = 1;
+        m_front = 2;
+        m_slot[0] = a_back;
+        m_slot[1] = a_middle;
+        m_slot[2] = a_front;
+    }
+
+    /**
+     * Writer side: slot to be filled.
+     */
+    T &Back() { return m_slot[m_back]; }
+
+    /**
+     * Writer side: make back slot the latest data. Returns true if previously
+     * published data was not taken by the reader and is now dropped.
+     */
+    bool Publish()
+    {
+        const unsigned old(m_middle.exchange(m_back | c_fresh, std::memory_order_acq_rel));
+        m_back = old & c_index;
+        return (old & c_fresh) != 0;
+    }
+
+    /**
+     * Reader side: check if there is data published since last Take.
+     */
+    bool IsFresh() const
+    {
+        return (m_middle.load(std::memory_order_acquire) & c_fresh) != 0;
+    }
+
+    /**
+     * Reader side: make the latest published data the front slot.
+     * Returns false and keeps the front slot if nothing new was published.
+     */
+    bool Take()
+    {
+        if (!IsFresh()) {
+            return false;
+        }
+        const unsigned old(m_middle.exchange(m_front, std::memory_order_acq_rel));
+        m_front = old & c_index;
+        return true;
+    }
+
+    /**
+     * Reader side: slot taken last.
+     */
+    T &Front() { return m_slot[m_front]; }
+
+private:
+    static const unsigned c_index = 0x3;
+    static const unsigned c_fresh = 0x4;
+
+    T                     m_slot[3];
+    unsigned              m_back;   // owned by writer
+    std::atomic<unsigned> m_middle; // slot index and fresh flag
+    unsigned              m_front;  // owned by reader
+};
+
+#endif //LIBERA_TRIPLE_BUFFER_H
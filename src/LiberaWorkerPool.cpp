@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#include <algorithm>
+#include <exception>
+
+#include <istd/trace.h>
+
+#include "LiberaWorkerPool.h"
+
+LiberaWorkerPool::LiberaWorkerPool(size_t a_threads)
+  : m_running(true),
+    m_seq(0),
+    m_base(a_threads),
+    m_reserved(0),
+    m_live(0)
+{
+    istd_FTRC();
+    std::lock_guard<std::mutex> l(m_x);
+    Resize();
+}
+
+/**
+ * Stop all threads, tasks being run are completed first.
+ */
+LiberaWorkerPool::~LiberaWorkerPool()
+{
+    istd_FTRC();
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        m_running = false;
+    }
+    m_cv.notify_all();
+    for (auto i = m_threads.begin(); i != m_threads.end(); ++i) {
+        if (i->joinable()) {
+            i->join();
+        }
+    }
+}
+
+bool LiberaWorkerPool::Later(const Entry &a, const Entry &b)
+{
+    return a.when > b.when;
+}
+
+/**
+ * Run the task at given time, replacing any previous schedule. If the task
+ * is being run, it is run again at given time after it completes.
+ */
+void LiberaWorkerPool::Schedule(LiberaTask *a_task, Clock::time_point a_when)
+{
+    std::lock_guard<std::mutex> l(m_x);
+    State &s(GetState(a_task));
+    if (s.running) {
+        // invalidate own reschedule of the running task
+        s.seq = ++m_seq;
+        s.rerun = true;
+        s.next = a_when;
+        return;
+    }
+    Queue(a_task, s, a_when);
+}
+
+/**
+ * Remove the task from schedule. With a_wait the call also waits for
+ * the task's current run to complete and forgets the task, which must be
+ * done before the task is destroyed. Must not be called with a_wait from
+ * the task's own Run.
+ */
+void LiberaWorkerPool::Cancel(LiberaTask *a_task, bool a_wait)
+{
+    std::unique_lock<std::mutex> l(m_x);
+    auto i = m_tasks.find(a_task);
+    if (i == m_tasks.end()) {
+        return;
+    }
+    // outdates the queued entry and own reschedule
+    i->second.seq = ++m_seq;
+    i->second.rerun = false;
+    if (a_wait) {
+        while (m_tasks[a_task].running) {
+            m_idle_cv.wait(l);
+        }
+        if (m_tasks[a_task].reserved) {
+            --m_reserved;
+            Resize();
+        }
+        m_tasks.erase(a_task);
+    }
+}
+
+/**
+ * Reserve a thread for a task that may block in Run, e.g. waiting for data
+ * to arrive, or drop its reservation. The reservation is dropped as well
+ * when the task is cancelled with a_wait.
+ */
+void LiberaWorkerPool::Reserve(LiberaTask *a_task, bool a_reserve)
+{
+    std::lock_guard<std::mutex> l(m_x);
+    if (!a_reserve && m_tasks.find(a_task) == m_tasks.end()) {
+        return;
+    }
+    State &s(GetState(a_task));
+    if (s.reserved == a_reserve) {
+        return;
+    }
+    s.reserved = a_reserve;
+    if (a_reserve) {
+        ++m_reserved;
+    }
+    else {
+        --m_reserved;
+    }
+    Resize();
+}
+
+/**
+ * Number of threads, including the reserved ones.
+ */
+size_t LiberaWorkerPool::GetSize() const
+{
+    std::lock_guard<std::mutex> l(m_x);
+    return m_live;
+}
+
+/**
+ * Find or add task state, called with the lock held.
+ */
+LiberaWorkerPool::State &LiberaWorkerPool::GetState(LiberaTask *a_task)
+{
+    auto i = m_tasks.find(a_task);
+    if (i == m_tasks.end()) {
+        State s = { 0, false, false, false, Clock::time_point() };
+        i = m_tasks.insert(std::make_pair(a_task, s)).first;
+    }
+    return i->second;
+}
+
+/**
+ * Add heap entry, called with the lock held.
+ */
+void LiberaWorkerPool::Queue(LiberaTask *a_task, State &a_state, Clock::time_point a_when)
+{
+    a_state.seq = ++m_seq;
+    Entry e = { a_when, a_task, a_state.seq };
+    m_heap.push_back(e);
+    std::push_heap(m_heap.begin(), m_heap.end(), Later);
+    m_cv.notify_one();
+}
+
+/**
+ * Start threads up to the base size plus reservations, or let the surplus
+ * ones exit once they are idle. Threads that have exited are joined here.
+ * Called with the lock held.
+ */
+void LiberaWorkerPool::Resize()
+{
+    const size_t target(m_base + m_reserved);
+    if (m_live > target) {
+        m_cv.notify_all();
+        return;
+    }
+    for (auto i = m_exited.begin(); i != m_exited.end(); ++i) {
+        for (auto t = m_threads.begin(); t != m_threads.end(); ++t) {
+            if (t->get_id() == *i) {
+                // has released the lock, it only returns
+                t->join();
+                m_threads.erase(t);
+                break;
+            }
+        }
+    }
+    m_exited.clear();
+    while (m_live < target) {
+        m_threads.push_back(std::thread(&LiberaWorkerPool::Worker, this));
+        ++m_live;
+    }
+}
+
+/**
+ * Worker thread function, runs the earliest due task.
+ */
+void LiberaWorkerPool::Worker()
+{
+    std::unique_lock<std::mutex> l(m_x);
+    while (m_running) {
+        if (m_live > m_base + m_reserved) {
+            // reservation dropped
+            --m_live;
+            m_exited.push_back(std::this_thread::get_id());
+            return;
+        }
+        if (m_heap.empty()) {
+            m_cv.wait(l);
+            continue;
+        }
+        Entry e(m_heap.front());
+        auto i = m_tasks.find(e.task);
+        if (i == m_tasks.end() || i->second.seq != e.seq) {
+            // cancelled or rescheduled
+            std::pop_heap(m_heap.begin(), m_heap.end(), Later);
+            m_heap.pop_back();
+            continue;
+        }
+        if (e.when > Clock::now()) {
+            m_cv.wait_until(l, e.when);
+            continue;
+        }
+        std::pop_heap(m_heap.begin(), m_heap.end(), Later);
+        m_heap.pop_back();
+        i->second.running = true;
+        const uint64_t seq(e.seq);
+        l.unlock();
+
+        Clock::time_point next;
+        bool again(false);
+        try {
+            again = e.task->Run(next);
+        }
+        catch (std::exception &ex) {
+            istd_TRC(istd::eTrcLow, "Exception thrown from task: " << ex.what());
+        }
+        catch (...) {
+            istd_TRC(istd::eTrcLow, "Unknown exception thrown from task");
+        }
+
+        l.lock();
+        State &s(m_tasks[e.task]);
+        s.running = false;
+        if (s.rerun) {
+            s.rerun = false;
+            Queue(e.task, s, s.next);
+        }
+        else if (again && s.seq == seq) {
+            Queue(e.task, s, next);
+        }
+        m_idle_cv.notify_all();
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_WORKER_POOL_H
+#define LIBERA_WORKER_POOL_H
+
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+/*******************************************************************************
+ * Unit of work executed by the worker pool.
+ */
+class LiberaTask {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    virtual ~LiberaTask() {}
+
+    /**
+     * Do one step of work. Return true and set a_next to be run again at
+     * that time, return false to be run only when scheduled again.
+     */
+    virtual bool Run(Clock::time_point &a_next) = 0;
+};
+
+/*******************************************************************************
+ * Threads executing scheduled tasks on their deadlines. A task is never run
+ * by more than one thread at a time, tasks that are not scheduled cost
+ * nothing. Tasks that may block in Run for a long time reserve a thread,
+ * the pool keeps one thread for each of them on top of its base size, so
+ * blocked tasks never hold all threads.
+ */
+class LiberaWorkerPool {
+public:
+    typedef LiberaTask::Clock Clock;
+
+    explicit LiberaWorkerPool(size_t a_threads);
+    ~LiberaWorkerPool();
+
+    void Schedule(LiberaTask *a_task, Clock::time_point a_when);
+    void Cancel(LiberaTask *a_task, bool a_wait);
+    void Reserve(LiberaTask *a_task, bool a_reserve);
+    size_t GetSize() const;
+
+private:
+    LiberaWorkerPool(const LiberaWorkerPool &);
+    LiberaWorkerPool &operator=(const LiberaWorkerPool &);
+
+    /**
+     * Heap entry, outdated when its sequence doesn't match the task's one.
+     */
+    struct Entry {
+        Clock::time_point when;
+        LiberaTask       *task;
+        uint64_t          seq;
+    };
+    struct State {
+        uint64_t          seq;      // sequence of valid heap entry
+        bool              running;
+        bool              rerun;    // scheduled while running
+        bool              reserved; // holds a thread reservation
+        Clock::time_point next;     // time of the rerun
+    };
+    static bool Later(const Entry &a, const Entry &b);
+    State &GetState(LiberaTask *a_task);
+    void Queue(LiberaTask *a_task, State &a_state, Clock::time_point a_when);
+    void Resize();
+    void Worker();
+
+    mutable std::mutex        m_x;
+    std::condition_variable   m_cv;      // wakes workers on new deadline
+    std::condition_variable   m_idle_cv; // signals task run completion
+    bool                      m_running;
+    uint64_t                  m_seq;
+    const size_t              m_base;     // threads without reservations
+    size_t                    m_reserved; // tasks holding a reservation
+    size_t                    m_live;     // threads not exiting
+    std::vector<Entry>        m_heap;    // by deadline, earliest first
+    std::unordered_map<LiberaTask *, State> m_tasks;
+    std::vector<std::thread>  m_threads;
+    std::vector<std::thread::id> m_exited; // surplus threads to be joined
+};
+
+#endif //LIBERA_WORKER_POOL_H
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#include <tango.h>
+#pragma GCC diagnostic warning "-Wold-style-cast"
+
+#include <istd/trace.h>
+
+#include "LiberaAttr.h"
+#include "LiberaWriteQueue.h"
+
+LiberaWriteQueue::LiberaWriteQueue(ErrorHandler a_onError)
+  : m_onError(a_onError),
+    m_running(true)
+{
+    istd_FTRC();
+    m_thread = std::thread(&LiberaWriteQueue::Run, this);
+}
+
+LiberaWriteQueue::~LiberaWriteQueue()
+{
+    istd_FTRC();
+    Stop();
+}
+
+/**
+ * Queue attribute with a new pending write.
+ */
+void LiberaWriteQueue::Push(LiberaAttr *a_attr)
+{
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        m_queue.push_back(a_attr);
+    }
+    m_cv.notify_one();
+}
+
+/**
+ * Stop the writer thread after writes queued so far are flushed. Must be
+ * called before queued attributes are destroyed.
+ */
+void LiberaWriteQueue::Stop()
+{
+    {
+        std::lock_guard<std::mutex> l(m_x);
+        m_running = false;
+    }
+    m_cv.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+/**
+ * Writer thread, flushes queued attributes in batches.
+ */
+void LiberaWriteQueue::Run()
+{
+    istd_FTRC();
+    std::vector<LiberaAttr *> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> l(m_x);
+            while (m_running && m_queue.empty()) {
+                m_cv.wait(l);
+            }
+            if (m_queue.empty()) {
+                return;
+            }
+            batch.swap(m_queue);
+        }
+        istd_TRC(istd::eTrcDetail, "Flushing writes: " << batch.size());
+        for (auto i = batch.begin(); i != batch.end(); ++i) {
+            try {
+                (*i)->Flush();
+            }
+            catch (istd::Exception e)
+            {
+                istd_TRC(istd::eTrcLow, "Exception thrown while writing to node!");
+                istd_TRC(istd::eTrcLow, e.what());
+                m_onError(e.what());
+            }
+            catch (std::exception &e)
+            {
+                istd_TRC(istd::eTrcLow, "Exception thrown while writing: " << e.what());
+                m_onError(e.what());
+            }
+            catch (...)
+            {
+                istd_TRC(istd::eTrcLow, "Unknown exception thrown while writing");
+                m_onError("Unknown exception thrown while writing");
+            }
+        }
+        batch.clear();
+    }
+}
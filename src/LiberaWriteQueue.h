@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2012 Instrumentation Technologies
+ * All Rights Reserved.
+ *
+ * $Id$
+ */
+
+#ifndef LIBERA_WRITE_QUEUE_H
+#define LIBERA_WRITE_QUEUE_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class LiberaAttr;
+
+/*******************************************************************************
+ * Attributes with pending asynchronous writes. Each attribute is queued once
+ * until its write is flushed, values written in the meantime replace the
+ * pending one. The writer thread flushes all queued attributes in a batch.
+ */
+class LiberaWriteQueue {
+public:
+    typedef std::function<void (const std::string &)> ErrorHandler;
+
+    explicit LiberaWriteQueue(ErrorHandler a_onError);
+    ~LiberaWriteQueue();
+
+    void Push(LiberaAttr *a_attr);
+    void Stop();
+
+private:
+    LiberaWriteQueue(const LiberaWriteQueue &);
+    LiberaWriteQueue &operator=(const LiberaWriteQueue &);
+
+    void Run();
+
+    ErrorHandler              m_onError;
+    std::mutex                m_x;
+    std::condition_variable   m_cv;
+    bool                      m_running;
+    std::vector<LiberaAttr *> m_queue;
+    std::thread               m_thread;
+};
+
+#endif //LIBERA_WRITE_QUEUE_H